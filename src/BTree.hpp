@@ -4,11 +4,16 @@
 
 #include "DupaDB.hpp"
 #include "FilePager.hpp"
+#include "util/latches.hpp"
+#include "util/search.hpp"
+#include "util/sort.hpp"
 
 #include <vector>
 #include <unordered_map>
 #include <set>
 
+#include <pthread.h>
+
 // File header for B-trees
 
 template <typename size_t, typename key_t, size_t _page_size>
@@ -19,6 +24,7 @@ struct BTreeHeader {
     uint32_t key_size;
     uint32_t page_size;
     uint32_t page_count;
+    uint32_t first_free_page;
     bool must_initialize;
 
     inline void set() {
@@ -27,6 +33,7 @@ struct BTreeHeader {
         key_size = sizeof(key_t);
         page_size = _page_size;
         page_count = 0;
+        first_free_page = 0;
         must_initialize = true;
     }
     inline const bool check() {
@@ -54,6 +61,9 @@ struct BTreePage {
         bool is_root : sizeof(size_t);
         size_t index;
         size_t keys_count;
+        // sibling leaves; 0 when there is none, as the root is nobody's sibling
+        size_t prev;
+        size_t next;
     };
     header_t header;
     // keys & indices
@@ -64,15 +74,13 @@ struct BTreePage {
         return header.keys_count >= max_keys_count;
     }
     inline const size_t find(const key_t& key) const {
-        if (key < keys[0]) {
-            return 0;
-        }
-        for (int i=1; i<header.keys_count; i++) {
-            if (key < keys[i]) {
-                return i;
-            }
-        }
-        return header.keys_count;
+        return upper_bound(key);
+    }
+    inline const size_t lower_bound(const key_t& key) const {
+        return SortedSearch<size_t, key_t>::lower_bound(keys, header.keys_count, key);
+    }
+    inline const size_t upper_bound(const key_t& key) const {
+        return SortedSearch<size_t, key_t>::upper_bound(keys, header.keys_count, key);
     }
     // insertion
     inline const bool insert_at(const size_t index, const key_t& key, const size_t value) {
@@ -101,6 +109,16 @@ struct BTreePage {
     inline const bool insert(const key_t& key, const size_t value) {
         return insert_at(find(key), key, value);
     }
+    // removal (in internal pages, the child on the right of the key goes too)
+    inline void erase_at(const size_t index) {
+        size_t keys_count = --header.keys_count;
+        memmove(keys + index, keys + index + 1, sizeof(key_t) * (keys_count - index));
+        if (header.is_leaf) {
+            memmove(values + index, values + index + 1, sizeof(size_t) * (keys_count - index));
+        } else {
+            memmove(values + index + 1, values + index + 2, sizeof(size_t) * (keys_count - index));
+        }
+    }
     // debugging
     inline void show() {
         debug("IS%s LEAF / IS%s ROOT", header.is_leaf ? "" : " NOT", header.is_root ? "" : " NOT");
@@ -118,7 +136,21 @@ template <typename size_t, typename key_t, size_t page_size>
 const size_t BTreePage<size_t, key_t, page_size>::max_keys_count = (page_size - sizeof(header_t) - sizeof(size_t)) / (sizeof(key_t) + sizeof(size_t));
 
 
+// BTree options, next to the FILEPAGER_* ones
+enum {
+    // resolve child references through swizzles (buffered pagers only)
+    BTREE_SWIZZLED = 1 << 16,
+};
+
+
 // The B-tree itself
+//
+// Concurrent access relies on optimistic lock coupling: each page has a
+// version latch, readers descend without writing anything and restart when a
+// version they went through changed, inserts only lock the pages they modify.
+// Erasing and bulk loading exclude other writers, but not readers. This is
+// only safe with FILEPAGER_MAPPED, where pages never move in memory: with a
+// buffer pool, operations from several threads at once are fatal.
 
 template <
     typename size_t, typename key_t,
@@ -128,53 +160,143 @@ template <
 struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_size, BTreePage<size_t, key_t, page_size>, pages_max_count> {
 
     static const size_t max_keys_count;
+    static const size_t min_keys_count;
     typedef BTreePage<size_t, key_t, page_size> page_t;
 
-    inline BTree(const char* file_path) :
+    LatchTable<size_t> _latches;
+    // swizzling (BTREE_SWIZZLED, buffered pagers only): each child reference
+    // is resolved through the frame the child was last found in, remembered
+    // per parent frame and slot, and checked against the page index before
+    // use, so that warm descents skip the page table
+    std::vector<size_t> _swizzles;
+    size_t _root_swizzle;
+    // page allocation
+    pthread_mutex_t _pages_mutex;
+    // shared by inserts, exclusive for erasing and bulk loading
+    pthread_rwlock_t _writers_lock;
+    // buffered pagers only: thread running an operation, if any
+    std::atomic<uint64_t> _buffered_owner;
+
+    // buffer pools are not thread-safe: with them, operations are refused
+    // while another thread is running one (operations nested in the same
+    // thread are fine)
+    struct exclusive_use_t {
+        std::atomic<uint64_t>* _owner;
+        inline exclusive_use_t(BTree* btree) : _owner(NULL) {
+            if (btree->_flags & FILEPAGER_MAPPED) {
+                return;
+            }
+            const uint64_t self = (uint64_t) pthread_self();
+            uint64_t owner = 0;
+            if (btree->_buffered_owner.compare_exchange_strong(owner, self, std::memory_order_acquire)) {
+                _owner = &btree->_buffered_owner;
+            } else if (owner != self) {
+                fatal("B-trees can only be shared between threads with FILEPAGER_MAPPED: `%s`", btree->_path.c_str());
+            }
+        }
+        inline ~exclusive_use_t() {
+            if (_owner) {
+                _owner->store(0, std::memory_order_release);
+            }
+        }
+    };
+
+    inline BTree(const char* file_path, const int flags=0) :
         FilePager<
             BTreeHeader<size_t, key_t, page_size>, size_t,
             page_size, BTreePage<size_t, key_t, page_size>, pages_max_count
-        >(file_path, reserve_size)
+        >(file_path, reserve_size, flags)
     {
+        pthread_mutex_init(&_pages_mutex, NULL);
+        pthread_rwlock_init(&_writers_lock, NULL);
+        _buffered_owner = 0;
+        _root_swizzle = -1;
+        if ((flags & BTREE_SWIZZLED) && !(flags & FILEPAGER_MAPPED)) {
+            _swizzles.assign(pages_max_count * (max_keys_count + 1), -1);
+        }
         if (this->header->must_initialize) {
             this->new_page().header.is_root = true;
+            this->header->must_initialize = false;
         }
     }
+    inline ~BTree() {
+        pthread_rwlock_destroy(&_writers_lock);
+        pthread_mutex_destroy(&_pages_mutex);
+    }
+
+    // read the page at `page_index`, which is in `slot` of the page held by
+    // `frame_index` (or the root when -1); `frame_index` is then updated
+    inline const page_t& read_child(const size_t page_index, size_t& frame_index, const size_t slot) {
+        if (_swizzles.empty()) {
+            return this->read_page(page_index);
+        }
+        size_t& swizzle = (frame_index == (size_t) -1) ? _root_swizzle : _swizzles[frame_index * (max_keys_count + 1) + slot];
+        const page_t& page = this->read_page(page_index, swizzle);
+        frame_index = swizzle;
+        return page;
+    }
 
     inline page_t& new_page() {
-        size_t page_index;
-        page_t& page = this->get_page(page_index = this->header->page_count++);
+        pthread_mutex_lock(&_pages_mutex);
+        size_t page_index = this->header->first_free_page;
+        if (page_index) {
+            // reuse a freed page
+            page_t& page = this->get_page(page_index);
+            this->header->first_free_page = page.header.next;
+        } else {
+            page_index = this->header->page_count++;
+        }
+        pthread_mutex_unlock(&_pages_mutex);
+        page_t& page = this->get_page(page_index);
         page.header = {
             .is_leaf = true,
             .is_root = false,
             .index = page_index,
-            .keys_count = 0
+            .keys_count = 0,
+            .prev = 0,
+            .next = 0
         };
         return page;
     }
+    // freed pages are chained through their `next` field
+    inline void free_page(const size_t page_index) {
+        pthread_mutex_lock(&_pages_mutex);
+        page_t& page = this->get_page(page_index);
+        page.header.keys_count = 0;
+        page.header.prev = 0;
+        page.header.next = this->header->first_free_page;
+        this->header->first_free_page = page_index;
+        pthread_mutex_unlock(&_pages_mutex);
+    }
 
     inline void split(page_t& page, const size_t parent_index=0) {
         static const size_t split_left = max_keys_count / 2;
         static const size_t split_right = max_keys_count - split_left;
         const key_t& split_key = page.keys[split_left];
+        // new pages get fetched below, `page` must stay resident meanwhile
+        this->pin(page.header.index);
         if (page.header.is_leaf) {
             if (page.header.is_root) {
                 // first new child
                 page_t& child1 = new_page();
+                const size_t child1_index = child1.header.index;
                 memcpy(child1.keys, page.keys, split_left * sizeof(key_t));
                 memcpy(child1.values, page.values, split_left * sizeof(size_t));
                 child1.header.keys_count = split_left;
                 // second new child
                 page_t& child2 = new_page();
+                const size_t child2_index = child2.header.index;
                 memcpy(child2.keys, page.keys + split_left, split_right * sizeof(key_t));
                 memcpy(child2.values, page.values + split_left, split_right * sizeof(size_t));
                 child2.header.keys_count = split_right;
+                child2.header.prev = child1_index;
+                this->get_page(child1_index).header.next = child2_index;
                 // original
                 page.header.keys_count = 1;
                 page.header.is_leaf = false;
                 page.keys[0] = split_key;
-                page.values[0] = child1.header.index;
-                page.values[1] = child2.header.index;
+                page.values[0] = child1_index;
+                page.values[1] = child2_index;
             } else {
                 // original page
                 page.header.keys_count = split_left;
@@ -183,20 +305,34 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 memcpy(sibling.keys, page.keys + split_left, split_right * sizeof(key_t));
                 memcpy(sibling.values, page.values + split_left, split_right * sizeof(size_t));
                 sibling.header.keys_count = split_right;
+                // link leaves
+                const size_t sibling_index = sibling.header.index;
+                sibling.header.prev = page.header.index;
+                sibling.header.next = page.header.next;
+                page.header.next = sibling_index;
+                if (sibling.header.next) {
+                    // leaves are always locked from left to right
+                    OptimisticLatch& next_latch = _latches[sibling.header.next];
+                    next_latch.write_lock();
+                    this->get_page(sibling.header.next).header.prev = sibling_index;
+                    next_latch.write_unlock();
+                }
                 // parent
                 page_t& parent = this->get_page(parent_index);
-                parent.insert(split_key, sibling.header.index);
+                parent.insert(split_key, sibling_index);
             }
         } else {
             if (page.header.is_root) {
                 // first new child
                 page_t& child1 = new_page();
+                const size_t child1_index = child1.header.index;
                 child1.header.is_leaf = false;
                 child1.header.keys_count = split_left;
                 memcpy(child1.keys, page.keys, split_left * sizeof(key_t));
                 memcpy(child1.values, page.values, (split_left + 1) * sizeof(size_t));
                 // second new child
                 page_t& child2 = new_page();
+                const size_t child2_index = child2.header.index;
                 child2.header.is_leaf = false;
                 child2.header.keys_count = split_right - 1;
                 memcpy(child2.keys, page.keys + split_left + 1, (split_right - 1) * sizeof(key_t));
@@ -204,8 +340,8 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 // original
                 page.header.keys_count = 1;
                 page.keys[0] = split_key;
-                page.values[0] = child1.header.index;
-                page.values[1] = child2.header.index;
+                page.values[0] = child1_index;
+                page.values[1] = child2_index;
             } else {
                 // new sibling
                 page_t& sibling = new_page();
@@ -216,136 +352,692 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 // original
                 page.header.keys_count = split_left;
                 // parent
+                const size_t sibling_index = sibling.header.index;
                 page_t& parent = this->get_page(parent_index);
-                parent.insert(split_key, sibling.header.index);
+                parent.insert(split_key, sibling_index);
             }
         }
+        this->unpin(page.header.index);
     }
 
     inline const bool insert(page_t& page, const key_t& key, const size_t value) {
         return page.insert(key, value);
     }
     inline const bool insert(const key_t& key, const size_t value) {
-        size_t parent_index = 0;
+        pthread_rwlock_rdlock(&_writers_lock);
+        while (!try_insert(key, value));
+        pthread_rwlock_unlock(&_writers_lock);
+        return true;
+    }
+    // one optimistic descent, splitting full pages on the way; returns false
+    // when it has to start over from the root
+    inline const bool try_insert(const key_t& key, const size_t value) {
+        exclusive_use_t exclusive_use(this);
+        size_t parent_index = -1;
+        uint64_t parent_version = 0;
         size_t page_index = 0;
+        uint64_t version = _latches[0].read_lock();
+        size_t frame_index = -1;
+        size_t slot = 0;
         while (true) {
-            page_t& page = this->get_page(page_index);
+            const page_t& page = read_child(page_index, frame_index, slot);
             if (page.is_full()) {
-                split(page, parent_index);
-                parent_index = page_index = 0;
-                continue;
+                // the page and its parent get locked, then split
+                if (parent_index != (size_t) -1 && !_latches[parent_index].upgrade(parent_version)) {
+                    return false;
+                }
+                if (!_latches[page_index].upgrade(version)) {
+                    if (parent_index != (size_t) -1) {
+                        _latches[parent_index].write_unlock();
+                    }
+                    return false;
+                }
+                split(this->get_page(page_index), (parent_index == (size_t) -1) ? 0 : parent_index);
+                _latches[page_index].write_unlock();
+                if (parent_index != (size_t) -1) {
+                    _latches[parent_index].write_unlock();
+                }
+                return false;
             }
             if (page.header.is_leaf) {
-                break;
+                if (!_latches[page_index].upgrade(version)) {
+                    return false;
+                }
+                insert(this->get_page(page_index), key, value);
+                _latches[page_index].write_unlock();
+                return true;
+            }
+            slot = page.find(key);
+            const size_t child_index = page.values[slot];
+            if (!_latches[page_index].check(version)) {
+                return false;
+            }
+            const uint64_t child_version = _latches[child_index].read_lock();
+            if (!_latches[page_index].check(version)) {
+                return false;
             }
             parent_index = page_index;
-            page_index = page.values[page.find(key)];
+            parent_version = version;
+            page_index = child_index;
+            version = child_version;
         }
-        page_t& page = this->get_page(page_index);
-        return insert(page, key, value);
     }
 
+    // removal: the entry is looked up from the root while remembering the
+    // path, then pages below `min_keys_count` borrow from or get merged with
+    // a sibling, from the leaf upwards
+    inline const bool erase(const key_t& key) {
+        return erase(key, 0, false);
+    }
+    inline const bool erase(const key_t& key, const size_t value, const bool match_value=true) {
+        pthread_rwlock_wrlock(&_writers_lock);
+        const bool result = erase_entry(key, value, match_value);
+        pthread_rwlock_unlock(&_writers_lock);
+        return result;
+    }
+    inline const bool erase_entry(const key_t& key, const size_t value, const bool match_value) {
+        exclusive_use_t exclusive_use(this);
+        size_t path_pages[32];
+        size_t path_slots[32];
+        size_t depth = 0;
+        size_t page_index = 0;
+        while (true) {
+            const page_t& page = this->read_page(page_index);
+            if (page.header.is_leaf) {
+                break;
+            }
+            const size_t slot = page.lower_bound(key);
+            path_pages[depth] = page_index;
+            path_slots[depth++] = slot;
+            page_index = page.values[slot];
+        }
+        // equal keys may span several leaves
+        while (true) {
+            const page_t& leaf = this->read_page(page_index);
+            size_t index = leaf.lower_bound(key);
+            for (; index<leaf.header.keys_count && !(key < leaf.keys[index]); index++) {
+                if (!match_value || leaf.values[index] == value) {
+                    _latches[page_index].write_lock();
+                    this->get_page(page_index).erase_at(index);
+                    _latches[page_index].write_unlock();
+                    rebalance(page_index, path_pages, path_slots, depth);
+                    return true;
+                }
+            }
+            if (index < leaf.header.keys_count) {
+                return false;
+            }
+            // move on to the next subtree, unless its keys are all greater
+            while (depth && path_slots[depth - 1] == this->read_page(path_pages[depth - 1]).header.keys_count) {
+                depth--;
+            }
+            if (depth == 0) {
+                return false;
+            }
+            const page_t& parent = this->read_page(path_pages[depth - 1]);
+            if (key < parent.keys[path_slots[depth - 1]]) {
+                return false;
+            }
+            page_index = parent.values[++path_slots[depth - 1]];
+            while (!this->read_page(page_index).header.is_leaf) {
+                path_pages[depth] = page_index;
+                path_slots[depth++] = 0;
+                page_index = this->read_page(page_index).values[0];
+            }
+        }
+    }
+    inline void rebalance(size_t page_index, const size_t* path_pages, const size_t* path_slots, size_t depth) {
+        while (depth--) {
+            if (this->read_page(page_index).header.keys_count >= min_keys_count) {
+                return;
+            }
+            const size_t parent_index = path_pages[depth];
+            const size_t slot = path_slots[depth];
+            const page_t& parent = this->read_page(parent_index);
+            const size_t left_index = (slot > 0) ? parent.values[slot - 1] : 0;
+            const size_t right_index = (slot < parent.header.keys_count) ? parent.values[slot + 1] : 0;
+            if (left_index && this->read_page(left_index).header.keys_count > min_keys_count) {
+                borrow(parent_index, slot - 1);
+                return;
+            }
+            if (right_index && this->read_page(right_index).header.keys_count > min_keys_count) {
+                borrow(parent_index, slot);
+                return;
+            }
+            merge(parent_index, left_index ? slot - 1 : slot);
+            page_index = parent_index;
+        }
+        // root collapse
+        if (!this->read_page(0).header.is_leaf && this->read_page(0).header.keys_count == 0) {
+            page_t& root = this->get_page(0);
+            const size_t child_index = root.values[0];
+            _latches[0].write_lock();
+            _latches[child_index].write_lock();
+            this->pin(0);
+            memcpy(&root, &this->read_page(child_index), page_size);
+            root.header.index = 0;
+            root.header.is_root = true;
+            this->unpin(0);
+            free_page(child_index);
+            _latches[child_index].write_unlock();
+            _latches[0].write_unlock();
+        }
+    }
+    // move one entry between the children on both sides of the parent's key
+    // at `slot`, towards the one that has fewer keys
+    inline void borrow(const size_t parent_index, const size_t slot) {
+        page_t& parent = this->get_page(parent_index);
+        this->pin(parent_index);
+        page_t& left = this->get_page(parent.values[slot]);
+        this->pin(left.header.index);
+        page_t& right = this->get_page(parent.values[slot + 1]);
+        const size_t left_index = left.header.index;
+        const size_t right_index = right.header.index;
+        _latches[parent_index].write_lock();
+        _latches[left_index].write_lock();
+        _latches[right_index].write_lock();
+        if (left.header.keys_count > right.header.keys_count) {
+            if (right.header.is_leaf) {
+                right.insert_at(0, left.keys[left.header.keys_count - 1], left.values[left.header.keys_count - 1]);
+                left.header.keys_count--;
+                parent.keys[slot] = right.keys[0];
+            } else {
+                memmove(right.keys + 1, right.keys, sizeof(key_t) * right.header.keys_count);
+                memmove(right.values + 1, right.values, sizeof(size_t) * (right.header.keys_count + 1));
+                right.keys[0] = parent.keys[slot];
+                right.values[0] = left.values[left.header.keys_count];
+                right.header.keys_count++;
+                parent.keys[slot] = left.keys[--left.header.keys_count];
+            }
+        } else {
+            if (left.header.is_leaf) {
+                left.insert_at(left.header.keys_count, right.keys[0], right.values[0]);
+                right.erase_at(0);
+                parent.keys[slot] = right.keys[0];
+            } else {
+                left.keys[left.header.keys_count] = parent.keys[slot];
+                left.values[++left.header.keys_count] = right.values[0];
+                parent.keys[slot] = right.keys[0];
+                memmove(right.keys, right.keys + 1, sizeof(key_t) * (right.header.keys_count - 1));
+                memmove(right.values, right.values + 1, sizeof(size_t) * right.header.keys_count);
+                right.header.keys_count--;
+            }
+        }
+        _latches[right_index].write_unlock();
+        _latches[left_index].write_unlock();
+        _latches[parent_index].write_unlock();
+        this->unpin(left_index);
+        this->unpin(parent_index);
+    }
+    // merge the children on both sides of the parent's key at `slot`
+    inline void merge(const size_t parent_index, const size_t slot) {
+        if (this->read_page(parent_index).header.keys_count == 0) {
+            fatal("cannot merge children of page %lu, which has a single one, in: `%s`", (uint64_t)parent_index, this->_path.c_str());
+        }
+        page_t& parent = this->get_page(parent_index);
+        this->pin(parent_index);
+        page_t& left = this->get_page(parent.values[slot]);
+        this->pin(left.header.index);
+        page_t& right = this->get_page(parent.values[slot + 1]);
+        const size_t left_index = left.header.index;
+        const size_t right_index = right.header.index;
+        _latches[parent_index].write_lock();
+        _latches[left_index].write_lock();
+        _latches[right_index].write_lock();
+        if (left.header.is_leaf) {
+            memcpy(left.keys + left.header.keys_count, right.keys, sizeof(key_t) * right.header.keys_count);
+            memcpy(left.values + left.header.keys_count, right.values, sizeof(size_t) * right.header.keys_count);
+            left.header.keys_count += right.header.keys_count;
+            left.header.next = right.header.next;
+            if (right.header.next) {
+                OptimisticLatch& next_latch = _latches[right.header.next];
+                next_latch.write_lock();
+                this->get_page(right.header.next).header.prev = left_index;
+                next_latch.write_unlock();
+            }
+        } else {
+            left.keys[left.header.keys_count] = parent.keys[slot];
+            memcpy(left.keys + left.header.keys_count + 1, right.keys, sizeof(key_t) * right.header.keys_count);
+            memcpy(left.values + left.header.keys_count + 1, right.values, sizeof(size_t) * (right.header.keys_count + 1));
+            left.header.keys_count += right.header.keys_count + 1;
+        }
+        parent.erase_at(slot);
+        this->unpin(left_index);
+        this->unpin(parent_index);
+        free_page(right_index);
+        _latches[right_index].write_unlock();
+        _latches[left_index].write_unlock();
+        _latches[parent_index].write_unlock();
+    }
+
+    // bulk loading: build an empty tree bottom-up from key/value pairs sorted
+    // by key, filling pages up to `fill_factor` (or at least up to
+    // `min_keys_count`); returns false when the tree is not empty, or when
+    // `fill_factor` is not within (0, 1]
+    template <typename iterator_t>
+    inline const bool load(iterator_t it, const iterator_t end, const double fill_factor=1.0) {
+        pthread_rwlock_wrlock(&_writers_lock);
+        const bool result = build(it, end, fill_factor);
+        pthread_rwlock_unlock(&_writers_lock);
+        return result;
+    }
+    template <typename iterator_t>
+    inline const bool build(iterator_t it, const iterator_t end, const double fill_factor) {
+        exclusive_use_t exclusive_use(this);
+        if (this->read_page(0).header.keys_count) {
+            error("cannot bulk load into a non-empty tree: `%s`", this->_path.c_str());
+            return false;
+        }
+        if (!(fill_factor > 0.0 && fill_factor <= 1.0)) {
+            error("cannot bulk load with a fill factor of %f: `%s`", fill_factor, this->_path.c_str());
+            return false;
+        }
+        const size_t leaf_capacity = std::max<size_t>(std::max<size_t>(1, min_keys_count), max_keys_count * fill_factor);
+        const size_t internal_capacity = std::max<size_t>(std::max<size_t>(1, min_keys_count), max_keys_count * fill_factor);
+        // rightmost page on each level, leaves first, and the one before it
+        std::vector<size_t> levels;
+        std::vector<size_t> lefts;
+        key_t previous_key = key_t();
+        while (it != end) {
+            // fill a new leaf
+            page_t& leaf = new_page();
+            const size_t leaf_index = leaf.header.index;
+            const size_t previous_index = levels.size() ? levels[0] : 0;
+            leaf.header.prev = previous_index;
+            size_t& keys_count = leaf.header.keys_count;
+            for (; keys_count<leaf_capacity && it!=end; ++it) {
+                if ((keys_count || levels.size()) && it->first < previous_key) {
+                    fatal("bulk loaded keys should be sorted in: `%s`", this->_path.c_str());
+                }
+                leaf.keys[keys_count] = it->first;
+                leaf.values[keys_count] = it->second;
+                previous_key = leaf.keys[keys_count++];
+            }
+            const key_t first_key = leaf.keys[0];
+            // link it to the previous one, and to the parent level
+            if (levels.size()) {
+                this->get_page(previous_index).header.next = leaf_index;
+                load_separator(levels, lefts, 1, first_key, leaf_index, internal_capacity);
+                lefts[0] = previous_index;
+                levels[0] = leaf_index;
+            } else {
+                levels.push_back(leaf_index);
+                lefts.push_back(0);
+            }
+        }
+        if (levels.empty()) {
+            return true;
+        }
+        balance_last_pages(levels, lefts);
+        // the topmost page becomes the root
+        page_t& root = this->get_page(0);
+        _latches[0].write_lock();
+        this->pin(0);
+        memcpy(&root, &this->read_page(levels.back()), page_size);
+        root.header.index = 0;
+        root.header.is_root = true;
+        this->unpin(0);
+        _latches[0].write_unlock();
+        free_page(levels.back());
+        return true;
+    }
+    inline void load_separator(std::vector<size_t>& levels, std::vector<size_t>& lefts, const size_t level, const key_t& key, const size_t child_index, const size_t capacity) {
+        if (level == levels.size()) {
+            // new topmost level, above the two first pages of the level below
+            page_t& page = new_page();
+            page.header.is_leaf = false;
+            page.header.keys_count = 1;
+            page.keys[0] = key;
+            page.values[0] = levels[level - 1];
+            page.values[1] = child_index;
+            levels.push_back(page.header.index);
+            lefts.push_back(0);
+            return;
+        }
+        page_t& page = this->get_page(levels[level]);
+        if (page.header.keys_count < capacity) {
+            page.values[++page.header.keys_count] = child_index;
+            page.keys[page.header.keys_count - 1] = key;
+            return;
+        }
+        // the current page is full: start a new one, and move the separator up
+        page_t& sibling = new_page();
+        const size_t sibling_index = sibling.header.index;
+        sibling.header.is_leaf = false;
+        sibling.values[0] = child_index;
+        load_separator(levels, lefts, level + 1, key, sibling_index, capacity);
+        lefts[level] = levels[level];
+        levels[level] = sibling_index;
+    }
+    // the last page of each level may have been left with fewer keys than
+    // `min_keys_count`, or none at all for internal pages: from the leaves
+    // up, it shares the keys of the page before it, or gets merged into it
+    inline void balance_last_pages(std::vector<size_t>& levels, std::vector<size_t>& lefts) {
+        for (size_t level=0; level+1<levels.size(); level++) {
+            const size_t right_index = levels[level];
+            const size_t left_index = lefts[level];
+            if (this->read_page(right_index).header.keys_count >= std::max<size_t>(1, min_keys_count)) {
+                continue;
+            }
+            // the key between both pages is the last one of the first page
+            // above that has any: pages in between only have a first child
+            size_t separator_level = level + 1;
+            while (separator_level < levels.size() && this->read_page(levels[separator_level]).header.keys_count == 0) {
+                separator_level++;
+            }
+            if (separator_level == levels.size()) {
+                break;
+            }
+            const size_t separator_index = levels[separator_level];
+            const bool is_leaf = this->read_page(right_index).header.is_leaf;
+            // keys and values of both pages, with the separator in between
+            // for internal ones
+            std::vector<key_t> keys;
+            std::vector<size_t> values;
+            const page_t& left = this->read_page(left_index);
+            keys.insert(keys.end(), left.keys, left.keys + left.header.keys_count);
+            values.insert(values.end(), left.values, left.values + left.header.keys_count + !is_leaf);
+            if (!is_leaf) {
+                const page_t& separator_page = this->read_page(separator_index);
+                keys.push_back(separator_page.keys[separator_page.header.keys_count - 1]);
+            }
+            const page_t& right = this->read_page(right_index);
+            keys.insert(keys.end(), right.keys, right.keys + right.header.keys_count);
+            values.insert(values.end(), right.values, right.values + right.header.keys_count + !is_leaf);
+            const size_t keys_count = keys.size() - !is_leaf;
+            if (keys_count >= 2 * min_keys_count) {
+                // both halves keep enough keys
+                const size_t left_count = keys_count / 2;
+                const size_t right_begin = left_count + !is_leaf;
+                page_t& new_left = this->get_page(left_index);
+                std::copy(keys.begin(), keys.begin() + left_count, new_left.keys);
+                std::copy(values.begin(), values.begin() + left_count + !is_leaf, new_left.values);
+                new_left.header.keys_count = left_count;
+                page_t& new_right = this->get_page(right_index);
+                std::copy(keys.begin() + right_begin, keys.end(), new_right.keys);
+                std::copy(values.begin() + left_count + !is_leaf, values.end(), new_right.values);
+                new_right.header.keys_count = keys.size() - right_begin;
+                page_t& separator_page = this->get_page(separator_index);
+                separator_page.keys[separator_page.header.keys_count - 1] = keys[left_count];
+                continue;
+            }
+            // everything fits in the left page; the right one goes, along with
+            // the pages above it up to the separator, which goes too
+            page_t& new_left = this->get_page(left_index);
+            std::copy(keys.begin(), keys.end(), new_left.keys);
+            std::copy(values.begin(), values.end(), new_left.values);
+            new_left.header.keys_count = keys_count + !is_leaf;
+            new_left.header.next = 0;
+            this->get_page(separator_index).header.keys_count--;
+            for (size_t l=level; l<separator_level; l++) {
+                free_page(levels[l]);
+                levels[l] = lefts[l];
+                lefts[l] = 0;
+            }
+        }
+        // a topmost page left without keys has a single child
+        while (levels.size() > 1 && this->read_page(levels.back()).header.keys_count == 0) {
+            free_page(levels.back());
+            levels.pop_back();
+            lefts.pop_back();
+        }
+    }
+    // bulk loading from unsorted pairs, sorted beforehand in runs of at most
+    // `run_size` pairs spilled next to the tree's file
+    template <typename iterator_t>
+    inline const bool load_unsorted(iterator_t it, const iterator_t end, const double fill_factor=1.0, const size_t run_size=1024*1024) {
+        ExternalSort<std::pair<key_t, size_t>> sort(this->_path + ".sort", run_size);
+        for (; it!=end; ++it) {
+            sort.push(std::pair<key_t, size_t>(it->first, it->second));
+        }
+        return load(sort.begin(), sort.end(), fill_factor);
+    }
+
+    // cursors hold a copy of the entry they are on, along with the version
+    // of its leaf: when the leaf changed meanwhile, the entry gets looked up
+    // again from the root before moving on
     struct cursor_t {
         BTree<size_t, key_t, reserve_size, page_size, pages_max_count>* _btree;
-        //
         size_t _page_index;
-        size_t _pages_indices[32];
-        size_t _pages_indices_count;
-        //
         size_t _index;
-        size_t _indices[32];
-        size_t _indices_count;
-        //
-        key_t* _key;
-        size_t* _value;
+        uint64_t _version;
+        key_t _key;
+        size_t _value;
+        // leaves ahead get prefetched once the cursor moved forward past its
+        // first leaf, as it is then likely to go on (see `scan`)
+        bool _is_prefetching;
+        bool _must_prefetch;
+        key_t _prefetch_key;
+        key_t _trigger_key;
 
-        inline cursor_t() : _btree(NULL) {
+        inline cursor_t() : _btree(NULL), _is_prefetching(false), _must_prefetch(false) {
             _page_index = -1;
             _index = -1;
         }
-        inline cursor_t(BTree<size_t, key_t, reserve_size, page_size, pages_max_count>* btree) : _btree(btree) {
-            _page_index = 0;
-            _pages_indices_count = _indices_count = 0;
-            _index = -1;
-            while (true) {
-                page_t* page = & _btree->get_page(_page_index);
-                if (page->header.keys_count == 0) {
-                    _page_index = -1;
-                    return;
-                }
-                if (page->header.is_leaf) {
-                    _key = page->keys;
-                    _value = page->values;
-                    _index = 0;
-                    return;
-                }
-                _pages_indices[_pages_indices_count++] = _page_index;
-                _indices[_indices_count++] = 0;
-                _page_index = page->values[0];
-            }
+        // position on the first key (or the last one, when `is_last` is set)
+        inline cursor_t(BTree<size_t, key_t, reserve_size, page_size, pages_max_count>* btree, const bool is_last=false) : _btree(btree), _is_prefetching(false), _must_prefetch(false) {
+            while (!locate(NULL, false, is_last));
+        }
+        // position on the first key not lower than `key` (or strictly
+        // greater, when `is_upper` is set), descending from the root
+        inline cursor_t(BTree<size_t, key_t, reserve_size, page_size, pages_max_count>* btree, const key_t& key, const bool is_upper) : _btree(btree), _is_prefetching(false), _must_prefetch(false) {
+            while (!locate(&key, is_upper, false));
         }
 
-        inline key_t& key() {
-            return *_key;
+        inline const key_t& key() {
+            return _key;
         }
-        inline size_t& value() {
-            return *_value;
+        inline const size_t& value() {
+            return _value;
         }
 
         inline void show_path() {
-            std::string result;
-            char buffer[256];
-            for (int i=0; i<_indices_count; i++) {
-                snprintf(buffer, sizeof(buffer), "(%u-%u) ", _pages_indices[i], _indices[i]);
-                result += buffer;
-            }
-            snprintf(buffer, sizeof(buffer), "(%u-%u)", _page_index, _index);
-            result += buffer;
-            warning("PATH: %s", result.c_str());
+            warning("PATH: (%u-%u)", _page_index, _index);
         }
 
         inline const bool operator != (const cursor_t& other) {
             return (_page_index != other._page_index) || (_index != other._index);
         }
+        // leaves are walked through their sibling links
         inline void operator ++ () {
-            while (true) {
-                page_t* page = & _btree->get_page(_page_index);
-                if (++_index < page->header.keys_count) {
-                    _key = page->keys + _index;
-                    _value = page->values + _index;
+            const size_t page_index = _page_index;
+            while (!step(true)) {
+                if (!relocate()) {
+                    // the entry is gone, its successor is already there
+                    break;
+                }
+            }
+            if (_page_index != page_index && _page_index != (size_t) -1) {
+                prefetch_ahead();
+            }
+        }
+        inline void operator -- () {
+            while (!step(false)) {
+                relocate();
+                if (_page_index == (size_t) -1) {
+                    while (!locate(NULL, false, true));
                     return;
                 }
-                while (true) {
-                    size_t max_index = page->header.keys_count;
-                    if (!page->header.is_leaf) {
-                        ++max_index;
+            }
+        }
+
+        // optimistic descent; when `key` is NULL, goes to the first entry (or
+        // the last one); returns false when it has to start over
+        inline const bool locate(const key_t* key, const bool is_upper, const bool is_last) {
+            exclusive_use_t exclusive_use(_btree);
+            size_t page_index = 0;
+            uint64_t version = _btree->_latches[0].read_lock();
+            size_t frame_index = -1;
+            size_t slot = 0;
+            while (true) {
+                const page_t& page = _btree->read_child(page_index, frame_index, slot);
+                size_t index;
+                if (key) {
+                    index = is_upper ? page.upper_bound(*key) : page.lower_bound(*key);
+                } else {
+                    index = is_last ? page.header.keys_count : 0;
+                }
+                if (page.header.is_leaf) {
+                    if (key == NULL && is_last) {
+                        return settle(page_index, version, index - 1, false);
                     }
-                    if (_index < max_index) {
-                        if (page->header.is_leaf) {
-                            break;
-                        }
-                        _pages_indices[_pages_indices_count++] = _page_index;
-                        _page_index = page->values[_index];
-                        _indices[_indices_count++] = _index;
-                        _index = 0;
-                    } else if (_pages_indices_count) {
-                        _page_index = _pages_indices[--_pages_indices_count];
-                        _index = _indices[--_indices_count] + 1;
-                    } else {
-                        _page_index = -1;
-                        _index = -1;
-                        return;
+                    return settle(page_index, version, index, true);
+                }
+                const size_t child_index = page.values[slot = index];
+                if (!_btree->_latches[page_index].check(version)) {
+                    return false;
+                }
+                const uint64_t child_version = _btree->_latches[child_index].read_lock();
+                if (!_btree->_latches[page_index].check(version)) {
+                    return false;
+                }
+                page_index = child_index;
+                version = child_version;
+            }
+        }
+        // copy the entry at `index` in a leaf read at `version`, moving on to
+        // the sibling leaves while out of bounds
+        inline const bool settle(size_t page_index, uint64_t version, size_t index, const bool forward) {
+            while (true) {
+                const page_t& page = _btree->read_page(page_index);
+                if (index < page.header.keys_count) {
+                    const key_t key = page.keys[index];
+                    const size_t value = page.values[index];
+                    if (!_btree->_latches[page_index].check(version)) {
+                        return false;
                     }
-                    page = & _btree->get_page(_page_index);
+                    _page_index = page_index;
+                    _index = index;
+                    _version = version;
+                    _key = key;
+                    _value = value;
+                    return true;
                 }
-                _key = page->keys + _index;
-                _value = page->values + _index;
-                return;
+                const size_t sibling_index = forward ? page.header.next : page.header.prev;
+                if (!_btree->_latches[page_index].check(version)) {
+                    return false;
+                }
+                if (sibling_index == 0) {
+                    _page_index = -1;
+                    _index = -1;
+                    return true;
+                }
+                const uint64_t sibling_version = _btree->_latches[sibling_index].read_lock();
+                if (!_btree->_latches[page_index].check(version)) {
+                    return false;
+                }
+                index = forward ? 0 : _btree->read_page(sibling_index).header.keys_count - 1;
+                page_index = sibling_index;
+                version = sibling_version;
+            }
+        }
+        // move to the neighbouring entry, unless the leaf changed
+        inline const bool step(const bool forward) {
+            exclusive_use_t exclusive_use(_btree);
+            const uint64_t version = _btree->_latches[_page_index].read_lock();
+            if (version != _version) {
+                return false;
+            }
+            return settle(_page_index, version, forward ? _index + 1 : _index - 1, forward);
+        }
+        // the first batch of leaves ahead gets prefetched along with the next
+        // one, which then gets prefetched once the cursor reaches it
+        inline void prefetch_ahead() {
+            exclusive_use_t exclusive_use(_btree);
+            if (!_is_prefetching) {
+                _is_prefetching = true;
+                _prefetch_key = _key;
+                _must_prefetch = _btree->prefetch_leaves(_prefetch_key, scan_prefetch_count, _prefetch_key);
+                _trigger_key = _prefetch_key;
+                _must_prefetch = _must_prefetch && _btree->prefetch_leaves(_prefetch_key, scan_prefetch_count, _prefetch_key);
+            } else if (_must_prefetch && !(_key < _trigger_key)) {
+                _trigger_key = _prefetch_key;
+                _must_prefetch = _btree->prefetch_leaves(_prefetch_key, scan_prefetch_count, _prefetch_key);
             }
         }
+        // look the current entry up again; returns false when it is gone, the
+        // cursor being then on the entry that follows
+        inline const bool relocate() {
+            const key_t key = _key;
+            const size_t value = _value;
+            while (true) {
+                while (!locate(&key, false, false));
+                bool is_stable = true;
+                while (_page_index != (size_t) -1 && !(key < _key)) {
+                    if (_value == value) {
+                        return true;
+                    }
+                    if (!step(true)) {
+                        is_stable = false;
+                        break;
+                    }
+                }
+                if (is_stable) {
+                    return false;
+                }
+            }
+        }
+    };
+    struct reverse_cursor_t : cursor_t {
+        inline reverse_cursor_t() : cursor_t() {}
+        inline reverse_cursor_t(BTree<size_t, key_t, reserve_size, page_size, pages_max_count>* btree) : cursor_t(btree, true) {}
+        inline void operator ++ () {
+            cursor_t::operator -- ();
+        }
     };
+    inline const bool erase(cursor_t& cursor) {
+        const key_t key = cursor.key();
+        const size_t value = cursor.value();
+        cursor = end();
+        return erase(key, value);
+    }
     inline cursor_t find(const key_t& key) {
-        return cursor_t(this);
+        cursor_t cursor = lower_bound(key);
+        if (cursor != end() && key < cursor.key()) {
+            return end();
+        }
+        return cursor;
+    }
+    // batched lookups: the pages on the paths of a batch of keys are fetched
+    // level by level, all reads of a level being in flight at once (see
+    // FilePager::fetch_many), then each key is looked up as with `find`
+    inline void find_many(const key_t* keys, const size_t count, cursor_t* cursors) {
+        exclusive_use_t exclusive_use(this);
+        static const size_t batch_max_size = std::max<size_t>(1, pages_max_count / 4);
+        static const size_t max_depth = 32;
+        size_t page_indices[batch_max_size];
+        for (size_t first=0; first<count; first+=batch_max_size) {
+            const size_t batch_size = std::min<size_t>(batch_max_size, count - first);
+            std::fill(page_indices, page_indices + batch_size, 0);
+            bool is_leaf_level = false;
+            for (size_t depth=0; !is_leaf_level && depth<max_depth; depth++) {
+                this->fetch_many(page_indices, batch_size);
+                for (size_t k=0; k<batch_size; k++) {
+                    const page_t& page = this->read_page(page_indices[k]);
+                    if (page.header.is_leaf) {
+                        is_leaf_level = true;
+                        continue;
+                    }
+                    // this is only a hint, as pages may change meanwhile
+                    const size_t child_index = page.values[page.lower_bound(keys[first + k])];
+                    if (child_index < this->header->page_count) {
+                        page_indices[k] = child_index;
+                    }
+                }
+            }
+            for (size_t k=0; k<batch_size; k++) {
+                cursors[first + k] = find(keys[first + k]);
+            }
+        }
+    }
+    inline cursor_t lower_bound(const key_t& key) {
+        return cursor_t(this, key, false);
+    }
+    inline cursor_t upper_bound(const key_t& key) {
+        return cursor_t(this, key, true);
+    }
+    inline std::pair<cursor_t, cursor_t> equal_range(const key_t& key) {
+        return std::pair<cursor_t, cursor_t>(lower_bound(key), upper_bound(key));
     }
     inline cursor_t begin() {
         return cursor_t(this);
@@ -353,13 +1045,136 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
     static inline cursor_t end() {
         return cursor_t();
     }
+    inline reverse_cursor_t rbegin() {
+        return reverse_cursor_t(this);
+    }
+    static inline reverse_cursor_t rend() {
+        return reverse_cursor_t();
+    }
 
+    // range scan over [lo, hi): leaves are streamed one after the other,
+    // each of them being copied once, while the leaves ahead get prefetched
+    // by batches of `scan_prefetch_count`, one batch ahead of the scan;
+    // stops early when `callback(key, value)` returns false, and returns the
+    // number of visited keys
+    static const size_t scan_prefetch_count = 16;
+    template <typename callback_t>
+    inline const size_t scan(const key_t& lo, const key_t& hi, callback_t callback) {
+        exclusive_use_t exclusive_use(this);
+        cursor_t cursor = lower_bound(lo);
+        // prefetching is done here instead, not past `hi`
+        cursor._is_prefetching = true;
+        key_t prefetch_key = lo;
+        bool must_prefetch = prefetch_leaves(prefetch_key, scan_prefetch_count, prefetch_key);
+        key_t trigger_key = prefetch_key;
+        must_prefetch = must_prefetch && prefetch_key < hi && prefetch_leaves(prefetch_key, scan_prefetch_count, prefetch_key);
+        page_t leaf;
+        size_t count = 0;
+        while (cursor._page_index != (size_t) -1) {
+            if (must_prefetch && !(cursor._key < trigger_key)) {
+                trigger_key = prefetch_key;
+                must_prefetch = prefetch_key < hi && prefetch_leaves(prefetch_key, scan_prefetch_count, prefetch_key);
+            }
+            // the cursor is on the first entry not visited yet
+            memcpy(&leaf, &this->read_page(cursor._page_index), sizeof(page_t));
+            if (!_latches[cursor._page_index].check(cursor._version)) {
+                cursor.relocate();
+                continue;
+            }
+            for (size_t index=cursor._index; index<leaf.header.keys_count; index++) {
+                if (!(leaf.keys[index] < hi) || !callback(leaf.keys[index], leaf.values[index])) {
+                    return count;
+                }
+                count++;
+            }
+            // carry on after the last entry of the leaf
+            cursor._index = leaf.header.keys_count - 1;
+            cursor._key = leaf.keys[cursor._index];
+            cursor._value = leaf.values[cursor._index];
+            ++cursor;
+        }
+        return count;
+    }
+
+    // prefetch up to `count` leaves, from the one where `key` would be, as
+    // listed in their parent; `next_key` is then set to the first key of the
+    // following leaves, if there are any
+    inline const bool prefetch_leaves(const key_t& key, const size_t count, key_t& next_key) {
+        size_t children[scan_prefetch_count];
+        while (true) {
+            size_t page_index = 0;
+            uint64_t version = _latches[0].read_lock();
+            // bound of the subtree being descended into
+            key_t bound = key_t();
+            bool is_bounded = false;
+            bool is_stable = true;
+            while (is_stable) {
+                const page_t& page = this->read_page(page_index);
+                if (page.header.is_leaf) {
+                    return false;
+                }
+                const size_t index = page.lower_bound(key);
+                const size_t keys_count = page.header.keys_count;
+                if (keys_count > max_keys_count || index > keys_count) {
+                    // read while being modified
+                    is_stable = false;
+                    break;
+                }
+                const size_t child_index = page.values[index];
+                if (index < keys_count) {
+                    bound = page.keys[index];
+                    is_bounded = true;
+                }
+                // the leaves to prefetch, in case the child is one of them:
+                // reading the child may evict the page
+                const size_t children_count = std::min<size_t>(std::min<size_t>(count, scan_prefetch_count), keys_count + 1 - index);
+                memcpy(children, page.values + index, children_count * sizeof(size_t));
+                const bool has_next = index + children_count <= keys_count;
+                const key_t key_next = has_next ? page.keys[index + children_count - 1] : bound;
+                if (!_latches[page_index].check(version) || child_index >= this->header->page_count) {
+                    is_stable = false;
+                    break;
+                }
+                const uint64_t child_version = _latches[child_index].read_lock();
+                const bool is_parent = this->read_page(child_index).header.is_leaf;
+                if (!_latches[child_index].check(child_version)) {
+                    is_stable = false;
+                    break;
+                }
+                if (!is_parent) {
+                    page_index = child_index;
+                    version = child_version;
+                    continue;
+                }
+                // consecutive leaves are prefetched together
+                for (size_t c=0, first=0; c<children_count; c++) {
+                    if (c + 1 == children_count || children[c + 1] != children[c] + 1) {
+                        if (children[c] < this->header->page_count) {
+                            this->prefetch(children[first], children[c] - children[first] + 1);
+                        }
+                        first = c + 1;
+                    }
+                }
+                if (has_next || is_bounded) {
+                    next_key = key_next;
+                    return true;
+                }
+                return false;
+            }
+        }
+    }
+
+    // consistency: keys are sorted, and internal pages have at least one key,
+    // or `min_keys_count` unless they are the root
     inline bool check() {
-        key_t nullkey;
+        key_t nullkey = key_t();
         return check(0, nullkey);
     }
     inline bool check(const size_t page_index, key_t& key) {
-        const page_t& page = this->get_page(page_index);
+        const page_t& page = this->read_page(page_index);
+        if (!page.header.is_leaf && (page.header.keys_count == 0 || (page_index != 0 && page.header.keys_count < min_keys_count))) {
+            return false;
+        }
         if (page.header.is_leaf) {
             for (uint32_t i=0, n=page.header.keys_count; i<n; i++) {
                 if (key > page.keys[i]) {
@@ -368,11 +1183,14 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 key = page.keys[i];
             }
         } else {
+            this->pin(page_index);
             for (uint32_t i=0, n=page.header.keys_count; i<=n; i++) {
                 if (!check(page.values[i], key) || page.values[i] == 0) {
+                    this->unpin(page_index);
                     return false;
                 }
             }
+            this->unpin(page_index);
         }
         return true;
     }
@@ -382,7 +1200,7 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
             // printf("BTREE\n");
             debug("BTREE");
         }
-        const page_t& page = this->get_page(page_index);
+        const page_t& page = this->read_page(page_index);
         std::string wrong_prefix(4 * (depth + 1), '|');
         std::string right_prefix(4 * (depth + 1), '.');
         key_t key;
@@ -394,6 +1212,7 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 debug("%s VALUE %-3u (%s)", prefix, page.values[i], page.keys[i]._data);
             }
         } else {
+            this->pin(page_index);
             for (uint32_t i=0, n=page.header.keys_count; i<=n; i++) {
                 key = page.keys[i];
                 if (i == 0) {
@@ -407,6 +1226,7 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
                 }
                 show(page.values[i], depth + 1);
             }
+            this->unpin(page_index);
         }
     }
     inline const bool show_check(const std::unordered_map<key_t, size_t>& key2value, bool show=false) {
@@ -477,6 +1297,10 @@ struct BTree : FilePager<BTreeHeader<size_t, key_t, page_size>, size_t, page_siz
 
 template <typename size_t, typename key_t, size_t reserve_size, size_t page_size, size_t pages_max_count>
 const size_t BTree<size_t, key_t, reserve_size, page_size, pages_max_count>::max_keys_count = BTreePage<size_t, key_t, page_size>::max_keys_count;
+template <typename size_t, typename key_t, size_t reserve_size, size_t page_size, size_t pages_max_count>
+const size_t BTree<size_t, key_t, reserve_size, page_size, pages_max_count>::min_keys_count = (BTreePage<size_t, key_t, page_size>::max_keys_count - 1) / 2;
+template <typename size_t, typename key_t, size_t reserve_size, size_t page_size, size_t pages_max_count>
+const size_t BTree<size_t, key_t, reserve_size, page_size, pages_max_count>::scan_prefetch_count;
 
 
 #endif // __INCLUDED__BTree_hpp__
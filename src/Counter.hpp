@@ -4,6 +4,9 @@
 
 #include "DupaDB.hpp"
 #include "FilePager.hpp"
+#include "util/latches.hpp"
+
+#include <algorithm>
 
 
 template <typename size_t>
@@ -12,13 +15,16 @@ struct CounterHeader {
     DupaHeader dupa;
     char subtype[8];
     size_t intsize;
+    // reserved identifiers, and the ones whose value was fully written
     size_t counter;
+    size_t published;
 
     inline void set() {
         dupa.set();
         memcpy(subtype, "FIXDCNTR", 8);
         intsize = sizeof(size_t);
         counter = 0;
+        published = 0;
     }
     inline const bool check() {
         return
@@ -51,12 +57,20 @@ struct Counter : FilePager<
 
     static const size_t values_per_page;
 
-    inline Counter(const char* path, size_t reserve_size) : FilePager<CounterHeader<size_t>, size_t, page_size, CounterPage<value_t, size_t, page_size>, pages_max_count>(path, reserve_size) {
+    PublishWatermark<size_t> _published;
+
+    inline Counter(const char* path, size_t reserve_size, const int flags=0) : FilePager<CounterHeader<size_t>, size_t, page_size, CounterPage<value_t, size_t, page_size>, pages_max_count>(path, reserve_size, flags) {
+        // identifiers reserved but never written before closing are dropped
+        this->header->counter = this->header->published;
+        _published.set(&this->header->published);
     }
 
+    // several threads may append at once with FILEPAGER_MAPPED, as mapped
+    // pages never move; values become visible to readers in order, once
+    // all the previous ones were written too
     inline const size_t append(const value_t& value) {
-        const size_t counter = this->header->counter++;
-        if (counter == -1) {
+        const size_t counter = __atomic_fetch_add(&this->header->counter, 1, __ATOMIC_RELAXED);
+        if (counter == (size_t) -1) {
             return 0;
         }
         memcpy(
@@ -64,8 +78,59 @@ struct Counter : FilePager<
             &value,
             sizeof(value_t)
         );
+        _published.mark(counter);
+        return counter + 1;
+    }
+    // batched appends: identifiers are reserved all at once, and values are
+    // copied by runs filling each page, fetched only once; returns the first
+    // identifier, the others following it
+    inline const size_t append_many(const value_t* values, const size_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        const size_t counter = __atomic_fetch_add(&this->header->counter, count, __ATOMIC_RELAXED);
+        if (counter > (size_t) -1 - count) {
+            return 0;
+        }
+        for (size_t done=0; done<count; ) {
+            const size_t index = (counter + done) % values_per_page;
+            const size_t run = std::min<size_t>(count - done, values_per_page - index);
+            memcpy(
+                this->get_page((counter + done) / values_per_page).values + index,
+                values + done,
+                run * sizeof(value_t)
+            );
+            done += run;
+        }
+        _published.mark(counter, count);
         return counter + 1;
     }
+    template <typename iterator_t>
+    inline const size_t append_many(iterator_t it, const iterator_t end) {
+        const size_t count = std::distance(it, end);
+        if (count == 0) {
+            return 0;
+        }
+        const size_t counter = __atomic_fetch_add(&this->header->counter, count, __ATOMIC_RELAXED);
+        if (counter > (size_t) -1 - count) {
+            return 0;
+        }
+        for (size_t done=0; done<count; ) {
+            const size_t index = (counter + done) % values_per_page;
+            const size_t run = std::min<size_t>(count - done, values_per_page - index);
+            value_t* destination = this->get_page((counter + done) / values_per_page).values + index;
+            for (size_t i=0; i<run; i++, ++it) {
+                memcpy(destination + i, &*it, sizeof(value_t));
+            }
+            done += run;
+        }
+        _published.mark(counter, count);
+        return counter + 1;
+    }
+    // number of values visible to readers: identifiers 1 to `published()`
+    inline const size_t published() const {
+        return _published.get();
+    }
     inline value_t& get(const size_t identifier) {
         size_t counter = identifier - 1;
         return this->get_page(counter / values_per_page).values[counter % values_per_page];
@@ -41,12 +41,15 @@ static const version_t dupa_version = {
 struct DupaHeader {
     char type[8];
     version_t version;
-    char version_name[52];
+    char version_name[44];
+    // write-ahead log position from which to recover (logged pagers only)
+    uint64_t checkpoint_lsn;
 
     inline void set() {
         strncpy(type, "DUPADB", sizeof(type));
         version = dupa_version;
         strncpy(version_name, "Sunny Afternoon", sizeof(version_name));
+        checkpoint_lsn = 0;
     }
     inline const bool check() const {
         return
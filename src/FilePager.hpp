@@ -2,8 +2,16 @@
 #define __INCLUDED__File_hpp__
 
 
+#include "util/arena.hpp"
+#include "util/latches.hpp"
 #include "util/logging.hpp"
+#include "util/pagetable.hpp"
+#include "util/uring.hpp"
+#include "util/wal.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -11,36 +19,39 @@
 
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 
 
 template <typename size_t>
 struct FileHandler {
 
-    const char* _path;
+    // a copy, as callers may pass temporary strings
+    std::string _path;
     size_t _handle;
     size_t _size;
     size_t _reserve_size;
 
     inline FileHandler(const char* path, const size_t reserve_size) {
         _path = path;
-        _handle = open(_path, O_RDWR | O_CREAT, 0666);
+        _handle = open(_path.c_str(), O_RDWR | O_CREAT, 0666);
         _reserve_size = reserve_size;
         if (_handle == -1) {
-            error("could not open: `%s`", _path);
+            error("could not open: `%s`", _path.c_str());
             fatal("%s", strerror(errno));
         }
         struct stat stat;
         if (fstat(_handle, &stat) == -1) {
-            error("error while reading stat for: `%s`", _path);
+            error("error while reading stat for: `%s`", _path.c_str());
             fatal("%s", strerror(errno));
         }
         _size = stat.st_size;
     }
     inline ~FileHandler() {
         if (close(_handle) == -1) {
-            fatal("could not close: `%s`", _path);
+            fatal("could not close: `%s`", _path.c_str());
         }
     }
 
@@ -53,7 +64,7 @@ struct FileHandler {
         }
         _size = max_size + (_reserve_size - max_size % _reserve_size);
         if (ftruncate(_handle, _size) == -1) {
-            fatal("error while resizing file: `%s` (%s)", _path, strerror(errno));
+            fatal("error while resizing file: `%s` (%s)", _path.c_str(), strerror(errno));
         }
         return _size;
     }
@@ -83,7 +94,9 @@ struct FileHandlerMap {
             _size = 0;
         }
     }
-    inline const bool set(const size_t offset, const size_t size) {
+    // `flags` are added to the mmap ones; with an `alignment`, addresses are
+    // congruent to file offsets modulo `alignment`, as huge pages need it
+    inline const bool set(const size_t offset, const size_t size, const int flags=0, const size_t alignment=0) {
         unset();
         size_t new_size = size + offset;
         if (new_size > _file_handler->size()) {
@@ -91,12 +104,23 @@ struct FileHandlerMap {
                 return false;
             }
         }
-        _data = (mapped_t*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, _file_handler->_handle, offset);;
+        void* address = NULL;
+        if (alignment) {
+            // reserve a larger range, then map the file inside of it
+            char* range = (char*) mmap(NULL, size + alignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (range != (void*) -1) {
+                char* aligned = range + ((uint64_t) offset - (uint64_t) range) % alignment;
+                munmap(range, aligned - range);
+                munmap(aligned + size, range + size + alignment - (aligned + size));
+                address = aligned;
+            }
+        }
+        _data = (mapped_t*) mmap(address, size, PROT_READ | PROT_WRITE, MAP_SHARED | (address ? MAP_FIXED : 0) | flags, _file_handler->_handle, offset);
         if (_data != (void*) -1) {
             _size = size;
             return true;
         }
-        fatal("could not map %u bytes from %s@%u", size, _file_handler->_path, offset);
+        fatal("could not map %u bytes from %s@%u", size, _file_handler->_path.c_str(), offset);
         return false;
     }
 
@@ -106,6 +130,51 @@ struct FileHandlerMap {
 };
 
 
+// pager options
+
+enum {
+    // serve pages straight out of mmap'd extents instead of buffered frames
+    FILEPAGER_MAPPED = 1 << 0,
+    // log page images in a write-ahead log next to the file, so that changes
+    // only reach the file once committed (buffered frames only)
+    FILEPAGER_LOGGED = 1 << 1,
+    // no readahead: pages are expected to be accessed randomly
+    FILEPAGER_RANDOM = 1 << 2,
+    // page I/O goes through io_uring, so that batches of reads and writes are
+    // in flight at once (buffered frames only; plain system calls are used
+    // when the kernel does not support it)
+    FILEPAGER_ASYNC = 1 << 3,
+    // mapped extents options: back them with transparent huge pages, where
+    // the file system supports it; pre-fault them when mapping, and map the
+    // whole file right away when opening; lock them in memory
+    FILEPAGER_HUGEPAGES = 1 << 4,
+    FILEPAGER_POPULATE = 1 << 5,
+    FILEPAGER_LOCKED = 1 << 6,
+};
+
+// durability policies, deciding when commits get synced
+enum {
+    // never, only checkpoints and closing sync
+    DURABILITY_NONE = 0,
+    // every `parameter` milliseconds, from a background thread
+    DURABILITY_PERIODIC = 1,
+    // every `parameter` commits
+    DURABILITY_OPERATIONS = 2,
+    // on every commit; commits from concurrent threads share syncs, which
+    // only happens with mapped pages, logged pagers having a single thread
+    DURABILITY_COMMIT = 3,
+};
+
+struct commit_stats_t {
+    uint64_t commits_count;
+    double commits_per_second;
+    uint64_t syncs_count;
+    // in seconds
+    double sync_latency;
+    double sync_max_latency;
+};
+
+
 template <
     typename header_t, typename size_t,
     size_t page_size, typename _page_t,
@@ -115,8 +184,9 @@ struct FilePager : FileHandler<size_t> {
 
     // extend page...
     struct page_t : _page_t {
+        // only meaningful for mapped pages
         inline void flush() {
-            msync(this, sizeof(this), MS_SYNC);
+            msync(this, page_size, MS_SYNC);
         }
     };
 
@@ -124,69 +194,840 @@ struct FilePager : FileHandler<size_t> {
     FileHandlerMap<size_t, header_t> header_map;
     header_t* header;
 
-    // other mapped pages
-    FileHandlerMap<size_t, page_t> __page_maps[pages_max_count];
-    size_t __page_maps_size;
-    size_t _page_uses[pages_max_count];
-    size_t _total_page_uses;
-    std::unordered_map<size_t, FileHandlerMap<size_t, page_t>&> _page_maps;
+    // buffer pool: at most `pages_max_count` frames are resident at once
+    struct frame_t {
+        page_t* page;
+        size_t page_index;
+        size_t pins;
+        bool is_referenced;
+        bool is_dirty;
+    };
+    frame_t _frames[pages_max_count];
+    size_t _frames_count;
+    size_t _clock_hand;
+    // frames memory, recycled instead of being freed
+    PageArena<size_t, page_size> _arena;
+    PageTable<size_t> _page_table;
+    off_t _pages_offset;
+
+    // mapped extents (FILEPAGER_MAPPED only): each one covers
+    // `_extent_pages` consecutive pages and is never unmapped before closing,
+    // so references to mapped pages stay valid for the pager's lifetime;
+    // mapped pages can be looked up from several threads at once
+    std::vector<FileHandlerMap<size_t, char>*> _extents;
+    std::vector<char**> _extents_data_retired;
+    std::atomic<char**> _extents_data;
+    std::atomic<size_t> _extents_count;
+    size_t _extents_capacity;
+    pthread_mutex_t _extents_mutex;
+    size_t _extent_pages;
+    int _flags;
+
+    // asynchronous I/O (FILEPAGER_ASYNC only)
+    IoRing* _ring;
+
+    // write-ahead log (FILEPAGER_LOGGED only): dirty pages never get written
+    // to the file directly; evicted or committed page images are appended to
+    // the log instead, and read back from there until the next checkpoint
+    // copies them to the file
+    WriteAheadLog<size_t>* _log;
+    std::unordered_map<size_t, uint64_t> _logged_pages;
+    uint64_t _checkpoint_size;
+    // background checkpoints: every `_checkpoint_size` bytes of log, the
+    // latest committed images get copied to the file by another thread, while
+    // the foreground carries on; `_checkpoint_mutex` guards `_logged_pages`
+    pthread_t _checkpointer;
+    bool _is_checkpointer_running;
+    bool _is_checkpointing;
+    pthread_mutex_t _checkpoint_mutex;
+    pthread_cond_t _checkpoint_wakeup;
+    std::vector<std::pair<size_t, uint64_t>> _checkpoint_pages;
+    uint64_t _checkpoint_header_lsn;
+    uint64_t _checkpoint_end_lsn;
+
+    // durability: unlogged commits are numbered, and syncing the file makes
+    // every commit numbered so far durable
+    int _durability;
+    uint64_t _durability_parameter;
+    std::atomic<uint64_t> _commits_count;
+    double _commits_since;
+    pthread_mutex_t _sync_mutex;
+    SyncGroup _file_sync;
+    // background flusher (DURABILITY_PERIODIC only)
+    pthread_t _flusher;
+    pthread_cond_t _flusher_wakeup;
 
     // constructor
-    inline FilePager(const char* path, size_t reserve_size) : FileHandler<size_t>(path, reserve_size) {
+    inline FilePager(const char* path, size_t reserve_size, const int flags=0) : FileHandler<size_t>(path, reserve_size) {
         if (reserve_size < page_size) {
             fatal("reserve_size should be greater than page_size; however, %lu < %lu", (uint64_t)reserve_size, (uint64_t)page_size);
         }
+        _flags = flags;
+        _extent_pages = reserve_size / page_size;
+        _extents_data = NULL;
+        _extents_count = 0;
+        _extents_capacity = 0;
+        pthread_mutex_init(&_extents_mutex, NULL);
+        _log = NULL;
+        _checkpoint_size = 64 * 1024 * 1024;
+        _is_checkpointer_running = false;
+        _is_checkpointing = false;
+        _checkpoint_end_lsn = 0;
+        pthread_mutex_init(&_checkpoint_mutex, NULL);
+        pthread_cond_init(&_checkpoint_wakeup, NULL);
+        _durability = DURABILITY_COMMIT;
+        _durability_parameter = 0;
+        _commits_count = 0;
+        _commits_since = millitime();
+        pthread_mutex_init(&_sync_mutex, NULL);
+        pthread_cond_init(&_flusher_wakeup, NULL);
+        if ((_flags & FILEPAGER_MAPPED) && (page_size % sysconf(_SC_PAGESIZE))) {
+            fatal("page_size should be a multiple of %ld to map pages; however, it is %lu", sysconf(_SC_PAGESIZE), (uint64_t)page_size);
+        }
+        if ((_flags & FILEPAGER_MAPPED) && (_flags & FILEPAGER_LOGGED)) {
+            fatal("mapped pages cannot be logged, as the kernel writes them back anytime: `%s`", this->_path.c_str());
+        }
+        if (_flags & FILEPAGER_RANDOM) {
+            posix_fadvise(this->_handle, 0, 0, POSIX_FADV_RANDOM);
+        }
+        _ring = NULL;
+        if ((_flags & FILEPAGER_ASYNC) && !(_flags & FILEPAGER_MAPPED)) {
+            _ring = new IoRing(pages_max_count);
+            if (!_ring->is_available()) {
+                warning("asynchronous I/O is not available, using system calls for: `%s` (%s)", this->_path.c_str(), strerror(errno));
+                delete _ring;
+                _ring = NULL;
+            }
+        }
         auto is_new = (this->size() == 0);
-        // initialize pages
-        __page_maps_size = 0;
-        memset(_page_uses, 0, sizeof(_page_uses));
-        _total_page_uses = 0;
+        // initialize frames
+        memset(_frames, 0, sizeof(_frames));
+        _frames_count = 0;
+        _clock_hand = 0;
+        // pages are stored right after the header, aligned on page_size
+        _pages_offset = ((sizeof(header_t) + page_size - 1) / page_size) * page_size;
         // set file handler
         header_map.set_handler(*this);
-        for (size_t i=0; i<pages_max_count; i++) {
-            __page_maps[i].set_handler(*this);
-        }
         // map header
         if (!header_map.set(0, sizeof(header_t))) {
-            fatal("could not map header for: `%s`", this->_path);
+            fatal("could not map header for: `%s`", this->_path.c_str());
         }
         header = header_map.data();
         // initialize header if necessary
         if (is_new) {
             header->set();
         }
+        // replay committed changes from the log, if any
+        if (_flags & FILEPAGER_LOGGED) {
+            recover(is_new);
+        }
         // check header
         if (!header->check()) {
-            fatal("invalid header for: `%s`", this->_path);
+            fatal("invalid header for: `%s`", this->_path.c_str());
+        }
+        // pre-fault existing pages
+        if ((_flags & FILEPAGER_MAPPED) && (_flags & FILEPAGER_POPULATE) && (off_t) this->size() > _pages_offset) {
+            map_extents((this->size() - _pages_offset - 1) / (_extent_pages * page_size));
         }
     }
     inline ~FilePager() {
+        set_durability(DURABILITY_NONE);
+        if (_log) {
+            stop_checkpointer();
+            checkpoint();
+            delete _log;
+            _log = NULL;
+        }
+        flush();
+        delete _ring;
         if (munmap(header, sizeof(header_t)) == -1) {
-            fatal("error while unmapping header for: `%s`", this->_path);
+            fatal("error while unmapping header for: `%s`", this->_path.c_str());
+        }
+        for (size_t e=0; e<_extents.size(); e++) {
+            delete _extents[e];
+        }
+        for (size_t r=0; r<_extents_data_retired.size(); r++) {
+            delete [] _extents_data_retired[r];
+        }
+        delete [] _extents_data.load();
+        pthread_mutex_destroy(&_extents_mutex);
+        pthread_cond_destroy(&_flusher_wakeup);
+        pthread_mutex_destroy(&_sync_mutex);
+        pthread_cond_destroy(&_checkpoint_wakeup);
+        pthread_mutex_destroy(&_checkpoint_mutex);
+        debug("close file `%s`", this->_path.c_str());
+    }
+
+    // access pages (the returned reference stays valid until the page gets
+    // evicted, which can only happen during a later call to `get_page` or
+    // `read_page`, unless the page is pinned)
+    inline page_t& get_page(const size_t page_index) {
+        if (_flags & FILEPAGER_MAPPED) {
+            return map_page(page_index);
+        }
+        frame_t& frame = _frames[fetch(page_index)];
+        frame.is_dirty = true;
+        return * frame.page;
+    }
+    inline const page_t& read_page(const size_t page_index) {
+        if (_flags & FILEPAGER_MAPPED) {
+            return map_page(page_index);
+        }
+        return * _frames[fetch(page_index)].page;
+    }
+    // same, `hint` being the frame the page was last found in: it is checked
+    // first, and updated when wrong
+    inline const page_t& read_page(const size_t page_index, size_t& hint) {
+        if (_flags & FILEPAGER_MAPPED) {
+            return map_page(page_index);
+        }
+        if (hint < _frames_count && _frames[hint].page_index == page_index) {
+            _frames[hint].is_referenced = true;
+            return * _frames[hint].page;
+        }
+        hint = fetch(page_index);
+        return * _frames[hint].page;
+    }
+    // give the frames of clean, unpinned pages back to the arena, e.g. once
+    // a large scan is over (references to them become invalid, as when they
+    // get evicted); returns the number of released frames
+    inline const size_t trim() {
+        size_t released_count = 0;
+        for (size_t f=0; f<_frames_count; ) {
+            frame_t& frame = _frames[f];
+            if (frame.pins || frame.is_dirty) {
+                f++;
+                continue;
+            }
+            _page_table.erase(frame.page_index);
+            _arena.release(frame.page);
+            // the last frame fills the hole
+            if (f != --_frames_count) {
+                frame = _frames[_frames_count];
+                _page_table.set(frame.page_index, f);
+            }
+            released_count++;
+        }
+        _clock_hand = 0;
+        return released_count;
+    }
+    inline void pin(const size_t page_index) {
+        if (_flags & FILEPAGER_MAPPED) {
+            return;
+        }
+        _frames[fetch(page_index)].pins++;
+    }
+    inline void unpin(const size_t page_index) {
+        if (_flags & FILEPAGER_MAPPED) {
+            return;
+        }
+        const size_t frame_index = _page_table.find(page_index);
+        if (frame_index == PageTable<size_t>::none || _frames[frame_index].pins == 0) {
+            fatal("page %lu is not pinned in: `%s`", (uint64_t)page_index, this->_path.c_str());
+        }
+        _frames[frame_index].pins--;
+    }
+
+    // write back every dirty frame (mapped extents are written back by the
+    // kernel itself); logged pagers commit instead
+    inline void flush() {
+        if (_log) {
+            commit();
+            return;
+        }
+        write_back();
+    }
+
+    // durability
+    inline void set_durability(const int durability, const uint64_t parameter=0) {
+        pthread_mutex_lock(&_sync_mutex);
+        const bool was_periodic = (_durability == DURABILITY_PERIODIC);
+        _durability = durability;
+        _durability_parameter = parameter;
+        pthread_cond_signal(&_flusher_wakeup);
+        pthread_mutex_unlock(&_sync_mutex);
+        if (was_periodic) {
+            pthread_join(_flusher, NULL);
+        }
+        if (durability == DURABILITY_PERIODIC) {
+            if (pthread_create(&_flusher, NULL, run_flusher, this)) {
+                fatal("could not start flusher for: `%s`", this->_path.c_str());
+            }
+        }
+    }
+    // make every commit so far durable
+    inline void sync() {
+        if (_log) {
+            _log->sync(_log->end_lsn());
+        } else {
+            sync_file(_commits_count.load());
+        }
+    }
+    inline const commit_stats_t commit_stats() {
+        const SyncStats& stats = _log ? _log->_stats : _file_sync._stats;
+        const uint64_t syncs_count = stats._syncs_count.load();
+        return {
+            .commits_count = _commits_count.load(),
+            .commits_per_second = _commits_count.load() / (millitime() - _commits_since),
+            .syncs_count = syncs_count,
+            .sync_latency = syncs_count ? 1e-9 * stats._sync_nanoseconds.load() / syncs_count : 0.0,
+            .sync_max_latency = 1e-9 * stats._sync_max_nanoseconds.load(),
+        };
+    }
+    inline void sync_file(const uint64_t commit_index) {
+        pthread_mutex_lock(&_sync_mutex);
+        _file_sync.sync(&_sync_mutex, commit_index, [&]() {
+            return _commits_count.load();
+        }, [&]() {
+            if (fdatasync(this->_handle) == -1) {
+                fatal("could not sync: `%s` (%s)", this->_path.c_str(), strerror(errno));
+            }
+        });
+        pthread_mutex_unlock(&_sync_mutex);
+    }
+    static inline void* run_flusher(void* pager) {
+        ((FilePager*) pager)->flusher();
+        return NULL;
+    }
+    inline void flusher() {
+        pthread_mutex_lock(&_sync_mutex);
+        while (_durability == DURABILITY_PERIODIC) {
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += _durability_parameter / 1000;
+            deadline.tv_nsec += (_durability_parameter % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&_flusher_wakeup, &_sync_mutex, &deadline);
+            if (_durability != DURABILITY_PERIODIC) {
+                break;
+            }
+            pthread_mutex_unlock(&_sync_mutex);
+            sync();
+            pthread_mutex_lock(&_sync_mutex);
+        }
+        pthread_mutex_unlock(&_sync_mutex);
+    }
+
+    // write-ahead log: a commit appends the images of dirty pages and the
+    // header to the log, then a commit record; non-durable commits return
+    // without syncing, and get synced along with the next durable one (or an
+    // explicit `sync`), so that many of them share a single fsync; returns
+    // the commit's index, counting commits since opening, with or without a
+    // log
+    inline const uint64_t commit() {
+        if (_log == NULL) {
+            // without a log, committing writes pages back to the file
+            write_back();
+            const uint64_t commit_index = ++_commits_count;
+            if (must_sync(commit_index)) {
+                sync_file(commit_index);
+            }
+            return commit_index;
+        }
+        const uint64_t commit_index = ++_commits_count;
+        uint64_t header_lsn;
+        const uint64_t lsn = log_commit(must_sync(commit_index), header_lsn);
+        if (lsn - _checkpoint_end_lsn >= _checkpoint_size) {
+            request_checkpoint(header_lsn, lsn);
+        }
+        return commit_index;
+    }
+    inline const bool must_sync(const uint64_t commit_index) const {
+        switch (_durability) {
+            case DURABILITY_OPERATIONS:
+                return _durability_parameter <= 1 || commit_index % _durability_parameter == 0;
+            case DURABILITY_COMMIT:
+                return true;
+            default:
+                return false;
+        }
+    }
+    // checkpoints copy the latest committed images to the file in page
+    // order, consecutive pages at once; this one then empties the log, and
+    // logs the header again right away, as the kernel may write uncommitted
+    // changes of the mapped header back to the file anytime
+    inline void checkpoint() {
+        uint64_t header_lsn;
+        log_commit(true, header_lsn);
+        pthread_mutex_lock(&_checkpoint_mutex);
+        while (_is_checkpointing) {
+            pthread_cond_wait(&_checkpoint_wakeup, &_checkpoint_mutex);
+        }
+        std::vector<std::pair<size_t, uint64_t>> pages(_logged_pages.begin(), _logged_pages.end());
+        store_logged_pages(pages);
+        if (msync(header, sizeof(header_t), MS_SYNC) == -1) {
+            fatal("could not sync header of: `%s` (%s)", this->_path.c_str(), strerror(errno));
+        }
+        _logged_pages.clear();
+        _log->truncate();
+        _log->append(WriteAheadLog<size_t>::WAL_HEADER, 0, header, sizeof(header_t));
+        _log->append(WriteAheadLog<size_t>::WAL_COMMIT, 0, NULL, 0);
+        _checkpoint_end_lsn = _log->end_lsn();
+        _log->sync(_checkpoint_end_lsn);
+        pthread_mutex_unlock(&_checkpoint_mutex);
+    }
+    inline void store_logged_pages(std::vector<std::pair<size_t, uint64_t>>& pages) {
+        std::sort(pages.begin(), pages.end());
+        static const size_t run_max_size = 64;
+        char* buffer = (char*) malloc(run_max_size * page_size);
+        if (buffer == NULL) {
+            fatal("could not allocate %lu bytes", (uint64_t)run_max_size * page_size);
+        }
+        for (size_t p=0; p<pages.size(); ) {
+            const size_t first_page_index = pages[p].first;
+            size_t run_size = 0;
+            for (; p<pages.size() && run_size<run_max_size && pages[p].first==first_page_index+run_size; p++) {
+                _log->read(pages[p].second, buffer + (run_size++) * page_size, page_size);
+            }
+            const off_t offset = page_offset(first_page_index);
+            this->reserve(offset + run_size * page_size);
+            if (pwrite(this->_handle, buffer, run_size * page_size, offset) != run_size * page_size) {
+                fatal("could not write %lu pages from %lu to: `%s` (%s)", (uint64_t)run_size, (uint64_t)first_page_index, this->_path.c_str(), strerror(errno));
+            }
+        }
+        free(buffer);
+        if (fdatasync(this->_handle) == -1) {
+            fatal("could not sync: `%s` (%s)", this->_path.c_str(), strerror(errno));
+        }
+    }
+    // hand the images committed up to `end_lsn` to the checkpointer, unless
+    // it is still busy with former ones
+    inline void set_checkpoint_size(const uint64_t checkpoint_size) {
+        _checkpoint_size = checkpoint_size;
+    }
+    inline void request_checkpoint(const uint64_t header_lsn, const uint64_t end_lsn) {
+        pthread_mutex_lock(&_checkpoint_mutex);
+        if (!_is_checkpointing) {
+            _checkpoint_pages.assign(_logged_pages.begin(), _logged_pages.end());
+            _checkpoint_header_lsn = header_lsn;
+            _checkpoint_end_lsn = end_lsn;
+            _is_checkpointing = true;
+            if (!_is_checkpointer_running) {
+                if (pthread_create(&_checkpointer, NULL, run_checkpointer, this)) {
+                    fatal("could not start checkpointer for: `%s`", this->_path.c_str());
+                }
+                _is_checkpointer_running = true;
+            }
+            pthread_cond_broadcast(&_checkpoint_wakeup);
+        }
+        pthread_mutex_unlock(&_checkpoint_mutex);
+    }
+    inline void stop_checkpointer() {
+        pthread_mutex_lock(&_checkpoint_mutex);
+        const bool was_running = _is_checkpointer_running;
+        _is_checkpointer_running = false;
+        pthread_cond_broadcast(&_checkpoint_wakeup);
+        pthread_mutex_unlock(&_checkpoint_mutex);
+        if (was_running) {
+            pthread_join(_checkpointer, NULL);
+        }
+    }
+    static inline void* run_checkpointer(void* pager) {
+        ((FilePager*) pager)->checkpointer();
+        return NULL;
+    }
+    inline void checkpointer() {
+        pthread_mutex_lock(&_checkpoint_mutex);
+        while (true) {
+            while (!_is_checkpointing && _is_checkpointer_running) {
+                pthread_cond_wait(&_checkpoint_wakeup, &_checkpoint_mutex);
+            }
+            if (!_is_checkpointing) {
+                break;
+            }
+            std::vector<std::pair<size_t, uint64_t>> pages;
+            pages.swap(_checkpoint_pages);
+            const uint64_t header_lsn = _checkpoint_header_lsn;
+            const uint64_t end_lsn = _checkpoint_end_lsn;
+            pthread_mutex_unlock(&_checkpoint_mutex);
+            // images must be durable in the log before reaching the file
+            _log->sync(end_lsn);
+            store_logged_pages(pages);
+            // recovery now starts from the checkpointed header
+            header->dupa.checkpoint_lsn = header_lsn;
+            if (msync(header, sizeof(header_t), MS_SYNC) == -1) {
+                fatal("could not sync header of: `%s` (%s)", this->_path.c_str(), strerror(errno));
+            }
+            // pages that were not logged again meanwhile are read from the
+            // file from now on, and their former images can go
+            pthread_mutex_lock(&_checkpoint_mutex);
+            for (size_t p=0; p<pages.size(); p++) {
+                auto it = _logged_pages.find(pages[p].first);
+                if (it != _logged_pages.end() && it->second == pages[p].second) {
+                    _logged_pages.erase(it);
+                }
+            }
+            _log->discard(header_lsn);
+            _is_checkpointing = false;
+            pthread_cond_broadcast(&_checkpoint_wakeup);
+        }
+        pthread_mutex_unlock(&_checkpoint_mutex);
+    }
+    inline const uint64_t log_commit(const bool is_durable, uint64_t& header_lsn) {
+        for (size_t f=0; f<_frames_count; f++) {
+            frame_t& frame = _frames[f];
+            if (frame.is_dirty) {
+                log_page(frame.page_index, frame.page);
+                frame.is_dirty = false;
+            }
+        }
+        header_lsn = _log->append(WriteAheadLog<size_t>::WAL_HEADER, 0, header, sizeof(header_t));
+        _log->append(WriteAheadLog<size_t>::WAL_COMMIT, 0, NULL, 0);
+        const uint64_t lsn = _log->end_lsn();
+        if (is_durable) {
+            _log->sync(lsn);
+        }
+        return lsn;
+    }
+    inline void log_page(const size_t page_index, const page_t* page) {
+        const uint64_t lsn = _log->append(WriteAheadLog<size_t>::WAL_PAGE, page_index, page, page_size);
+        pthread_mutex_lock(&_checkpoint_mutex);
+        _logged_pages[page_index] = lsn;
+        pthread_mutex_unlock(&_checkpoint_mutex);
+    }
+    inline void recover(const bool is_new) {
+        _log = new WriteAheadLog<size_t>(this->_path + ".wal");
+        if (is_new) {
+            // leftovers from a former file
+            _log->truncate();
+        }
+        // only the tail after the last checkpoint gets replayed
+        const uint64_t checkpoint_lsn = header->dupa.checkpoint_lsn;
+        uint64_t header_lsn = 0;
+        _log->recover([&](const typename WriteAheadLog<size_t>::record_t& record, const uint64_t lsn) {
+            if (record.type == WriteAheadLog<size_t>::WAL_HEADER) {
+                header_lsn = lsn;
+            } else if (record.type == WriteAheadLog<size_t>::WAL_PAGE) {
+                _logged_pages[record.page_index] = lsn;
+            }
+        }, checkpoint_lsn);
+        if (header_lsn) {
+            _log->read(header_lsn, header, sizeof(header_t));
+            header->dupa.checkpoint_lsn = checkpoint_lsn;
+        }
+        if (_logged_pages.size()) {
+            notice("recovered %lu pages from: `%s.wal`", (uint64_t)_logged_pages.size(), this->_path.c_str());
+        }
+        checkpoint();
+    }
+
+    // readahead: ask the kernel to start reading `count` pages from
+    // `page_index`, without waiting for them (mapped pagers only prefetch
+    // from extents that are already mapped)
+    inline void prefetch(const size_t page_index, const size_t count) {
+        if (!(_flags & FILEPAGER_MAPPED)) {
+            posix_fadvise(this->_handle, page_offset(page_index), (off_t) count * page_size, POSIX_FADV_WILLNEED);
+            return;
+        }
+        for_mapped_ranges(page_index, count, [](char* address, const size_t length) {
+            madvise(address, length, MADV_WILLNEED);
+        });
+    }
+    // keep hot pages in memory (mapped pagers only, within mapped extents);
+    // returns false when the memory lock limit was reached
+    inline const bool lock(const size_t page_index, const size_t count) {
+        bool is_locked = true;
+        for_mapped_ranges(page_index, count, [&](char* address, const size_t length) {
+            is_locked = (mlock(address, length) == 0) && is_locked;
+        });
+        return is_locked;
+    }
+    inline void unlock(const size_t page_index, const size_t count) {
+        for_mapped_ranges(page_index, count, [](char* address, const size_t length) {
+            munlock(address, length);
+        });
+    }
+    // `callback(address, length)` gets called for each part of a range of
+    // pages lying in a different extent
+    template <typename callback_t>
+    inline void for_mapped_ranges(const size_t page_index, const size_t count, callback_t callback) {
+        if (!(_flags & FILEPAGER_MAPPED)) {
+            return;
+        }
+        const size_t end = std::min<size_t>(page_index + count, _extents_count.load(std::memory_order_acquire) * _extent_pages);
+        for (size_t first=page_index; first<end; ) {
+            const size_t extent_index = first / _extent_pages;
+            const size_t last = std::min<size_t>(end, (extent_index + 1) * _extent_pages);
+            callback(_extents_data.load(std::memory_order_acquire)[extent_index] + (first % _extent_pages) * page_size, (last - first) * page_size);
+            first = last;
+        }
+    }
+    // sequential accesses get detected for each thread; once a run of
+    // `readahead_min_run` pages was accessed in order, the next ones are
+    // prefetched by windows growing with the run, up to `readahead_max_pages`
+    static const size_t readahead_min_run = 2;
+    static const size_t readahead_max_pages = 256;
+    struct readahead_t {
+        const void* pager;
+        size_t last_page_index;
+        size_t run;
+        size_t end;
+    };
+    inline void detect_sequential(const size_t page_index) {
+        static thread_local readahead_t readahead = {NULL, 0, 0, 0};
+        if (readahead.pager != this) {
+            readahead = {this, page_index, 0, 0};
+            return;
+        }
+        if (page_index == readahead.last_page_index) {
+            return;
+        }
+        const bool is_sequential = (page_index == readahead.last_page_index + 1);
+        readahead.last_page_index = page_index;
+        if (!is_sequential) {
+            readahead.run = 0;
+            readahead.end = 0;
+            return;
+        }
+        if (++readahead.run < readahead_min_run) {
+            return;
+        }
+        // prefetch again once half of the previous window was consumed
+        const size_t window = std::min<size_t>(readahead_max_pages, 16 << std::min<size_t>(readahead.run / 16, 4));
+        if (readahead.end > page_index + window / 2) {
+            return;
+        }
+        const size_t first = std::max<size_t>(readahead.end, page_index + 1);
+        readahead.end = page_index + 1 + window;
+        prefetch(first, readahead.end - first);
+    }
+
+    // mapped extents internals
+    static const size_t huge_page_size = 2 * 1024 * 1024;
+    inline page_t& map_page(const size_t page_index) {
+        if (!(_flags & FILEPAGER_RANDOM)) {
+            detect_sequential(page_index);
         }
-        for (auto it=pages.begin(); it!=pages.end(); it++) {
-            free(it->second);
+        const size_t extent_index = page_index / _extent_pages;
+        if (extent_index >= _extents_count.load(std::memory_order_acquire)) {
+            map_extents(extent_index);
         }
-        debug("close file `%s`", this->_path);
+        return * (page_t*) (_extents_data.load(std::memory_order_acquire)[extent_index] + (page_index % _extent_pages) * page_size);
+    }
+    inline void map_extents(const size_t extent_index) {
+        pthread_mutex_lock(&_extents_mutex);
+        while (extent_index >= _extents.size()) {
+            FileHandlerMap<size_t, char>* extent = new FileHandlerMap<size_t, char>();
+            extent->set_handler(*this);
+            const off_t offset = _pages_offset + (off_t) _extents.size() * _extent_pages * page_size;
+            const size_t size = _extent_pages * page_size;
+            if (!extent->set(offset, size, (_flags & FILEPAGER_POPULATE) ? MAP_POPULATE : 0, (_flags & FILEPAGER_HUGEPAGES) ? huge_page_size : 0)) {
+                fatal("could not map extent #%lu for: `%s`", (uint64_t)_extents.size(), this->_path.c_str());
+            }
+            if ((_flags & FILEPAGER_HUGEPAGES) && madvise(extent->data(), size, MADV_HUGEPAGE) == -1 && _extents.empty()) {
+                warning("no transparent huge pages for: `%s` (%s)", this->_path.c_str(), strerror(errno));
+            }
+            if ((_flags & FILEPAGER_LOCKED) && mlock(extent->data(), size) == -1) {
+                warning("could not lock extent #%lu of: `%s` in memory (%s)", (uint64_t)_extents.size(), this->_path.c_str(), strerror(errno));
+            }
+            _extents.push_back(extent);
+            // the addresses array gets replaced when full; former ones are
+            // kept until closing, as other threads may still be reading them
+            char** extents_data = _extents_data.load();
+            if (_extents.size() > _extents_capacity) {
+                _extents_capacity = _extents_capacity ? 2 * _extents_capacity : 16;
+                char** new_extents_data = new char*[_extents_capacity];
+                if (extents_data) {
+                    memcpy(new_extents_data, extents_data, (_extents.size() - 1) * sizeof(char*));
+                    _extents_data_retired.push_back(extents_data);
+                }
+                _extents_data.store(extents_data = new_extents_data, std::memory_order_release);
+            }
+            extents_data[_extents.size() - 1] = extent->data();
+            _extents_count.store(_extents.size(), std::memory_order_release);
+        }
+        pthread_mutex_unlock(&_extents_mutex);
     }
 
-    // access pages
-    std::unordered_map<size_t, page_t*> pages;
-    inline page_t& get_page(size_t page_index) {
-        auto it = pages.find(page_index);
-        if (it != pages.end()) {
-            return * it->second;
+    // buffer pool internals
+    inline const size_t fetch(const size_t page_index) {
+        size_t frame_index = _page_table.find(page_index);
+        if (frame_index != PageTable<size_t>::none) {
+            _frames[frame_index].is_referenced = true;
+            return frame_index;
+        }
+        if (!(_flags & FILEPAGER_RANDOM)) {
+            detect_sequential(page_index);
+        }
+        frame_index = assign_frame(page_index);
+        load_page(page_index, _frames[frame_index].page);
+        return frame_index;
+    }
+    // bring several pages in at once: with FILEPAGER_ASYNC, their reads are
+    // all in flight together, otherwise the kernel is asked to prefetch them
+    inline void fetch_many(const size_t* page_indices, const size_t count) {
+        if (_ring == NULL) {
+            for (size_t i=0; i<count; i++) {
+                prefetch(page_indices[i], 1);
+            }
+            return;
+        }
+        // frames stay pinned while being read, and at most half of them are
+        const size_t batch_max_size = std::min<size_t>(pages_max_count / 2, _ring->capacity());
+        auto complete = [&](const uint64_t frame_index, const int result) {
+            if (result != page_size) {
+                fatal("could not read page %lu from: `%s` (%s)", (uint64_t)_frames[frame_index].page_index, this->_path.c_str(), (result < 0) ? strerror(-result) : "short read");
+            }
+            _frames[frame_index].pins--;
+        };
+        size_t batch_size = 0;
+        for (size_t i=0; i<count; i++) {
+            const size_t page_index = page_indices[i];
+            if (_page_table.find(page_index) != PageTable<size_t>::none) {
+                continue;
+            }
+            const size_t frame_index = assign_frame(page_index);
+            frame_t& frame = _frames[frame_index];
+            const off_t offset = page_offset(page_index);
+            if (is_logged(page_index) || (uint64_t) offset + page_size > (uint64_t) this->size()) {
+                load_page(page_index, frame.page);
+                continue;
+            }
+            frame.pins++;
+            _ring->read(this->_handle, frame.page, page_size, offset, frame_index);
+            if (++batch_size == batch_max_size) {
+                _ring->wait(complete);
+                batch_size = 0;
+            }
+        }
+        _ring->wait(complete);
+    }
+    inline const size_t assign_frame(const size_t page_index) {
+        size_t frame_index;
+        if (_frames_count < pages_max_count) {
+            frame_index = _frames_count++;
+            _frames[frame_index].page = (page_t*) _arena.allocate();
+        } else {
+            frame_index = evict();
+        }
+        frame_t& frame = _frames[frame_index];
+        frame.page_index = page_index;
+        frame.pins = 0;
+        frame.is_referenced = true;
+        frame.is_dirty = false;
+        _page_table.set(page_index, frame_index);
+        return frame_index;
+    }
+    inline const size_t evict() {
+        // CLOCK: give referenced frames a second chance, never touch pinned ones
+        for (size_t n=0; n<2*pages_max_count; n++) {
+            const size_t frame_index = _clock_hand;
+            frame_t& frame = _frames[frame_index];
+            _clock_hand = (_clock_hand + 1) % pages_max_count;
+            if (frame.pins) {
+                continue;
+            }
+            if (frame.is_referenced) {
+                frame.is_referenced = false;
+                continue;
+            }
+            if (frame.is_dirty) {
+                if (_log) {
+                    log_page(frame.page_index, frame.page);
+                } else {
+                    store_page(frame.page_index, frame.page);
+                }
+            }
+            _page_table.erase(frame.page_index);
+            return frame_index;
+        }
+        fatal("all %lu frames are pinned in: `%s`", (uint64_t)pages_max_count, this->_path.c_str());
+        return -1;
+    }
+    inline const off_t page_offset(const size_t page_index) const {
+        return _pages_offset + (off_t) page_index * page_size;
+    }
+    // whether the latest image of a page is in the log rather than the file
+    inline const bool is_logged(const size_t page_index) {
+        if (_log == NULL) {
+            return false;
+        }
+        pthread_mutex_lock(&_checkpoint_mutex);
+        const bool result = (_logged_pages.find(page_index) != _logged_pages.end());
+        pthread_mutex_unlock(&_checkpoint_mutex);
+        return result;
+    }
+    inline void load_page(const size_t page_index, page_t* page) {
+        if (_log) {
+            pthread_mutex_lock(&_checkpoint_mutex);
+            auto it = _logged_pages.find(page_index);
+            const bool is_logged = (it != _logged_pages.end());
+            if (is_logged) {
+                _log->read(it->second, page, page_size);
+            }
+            pthread_mutex_unlock(&_checkpoint_mutex);
+            if (is_logged) {
+                return;
+            }
+        }
+        const off_t offset = page_offset(page_index);
+        if ((uint64_t) offset + page_size > (uint64_t) this->size()) {
+            memset(page, 0, page_size);
+            return;
         }
-        page_t* page = (page_t*) malloc(page_size);
-        if (page == NULL) {
-            fatal("could not allocate %u bytes", page_size);
+        if (pread(this->_handle, page, page_size, offset) != page_size) {
+            fatal("could not read page %lu from: `%s` (%s)", (uint64_t)page_index, this->_path.c_str(), strerror(errno));
+        }
+    }
+    // dirty frames get written in page order, consecutive pages at once
+    inline void write_back() {
+        std::vector<std::pair<size_t, size_t>> dirty;
+        for (size_t f=0; f<_frames_count; f++) {
+            if (_frames[f].is_dirty) {
+                dirty.push_back(std::pair<size_t, size_t>(_frames[f].page_index, f));
+            }
+        }
+        std::sort(dirty.begin(), dirty.end());
+        static const size_t run_max_size = 64;
+        // with FILEPAGER_ASYNC, all runs are written at once
+        std::vector<iovec> iov(dirty.size());
+        std::vector<std::pair<size_t, size_t>> runs;
+        for (size_t d=0; d<dirty.size(); ) {
+            const size_t first_page_index = dirty[d].first;
+            iovec* run = iov.data() + d;
+            size_t run_size = 0;
+            for (; d<dirty.size() && run_size<run_max_size && dirty[d].first==first_page_index+run_size; d++) {
+                frame_t& frame = _frames[dirty[d].second];
+                run[run_size].iov_base = frame.page;
+                run[run_size++].iov_len = page_size;
+                frame.is_dirty = false;
+            }
+            const off_t offset = page_offset(first_page_index);
+            this->reserve(offset + run_size * page_size);
+            if (_ring) {
+                _ring->writev(this->_handle, run, run_size, offset, runs.size());
+                runs.push_back(std::pair<size_t, size_t>(first_page_index, run_size));
+            } else if (pwritev(this->_handle, run, run_size, offset) != run_size * page_size) {
+                fatal("could not write %lu pages from %lu to: `%s` (%s)", (uint64_t)run_size, (uint64_t)first_page_index, this->_path.c_str(), strerror(errno));
+            }
+        }
+        if (_ring) {
+            _ring->wait([&](const uint64_t r, const int result) {
+                if (result != runs[r].second * page_size) {
+                    fatal("could not write %lu pages from %lu to: `%s` (%s)", (uint64_t)runs[r].second, (uint64_t)runs[r].first, this->_path.c_str(), (result < 0) ? strerror(-result) : "short write");
+                }
+            });
+        }
+    }
+    inline void store_page(const size_t page_index, const page_t* page) {
+        const off_t offset = page_offset(page_index);
+        this->reserve(offset + page_size);
+        if (pwrite(this->_handle, page, page_size, offset) != page_size) {
+            fatal("could not write page %lu to: `%s` (%s)", (uint64_t)page_index, this->_path.c_str(), strerror(errno));
         }
-        memset(page, 0, page_size);
-        pages.insert(std::pair<size_t, page_t*>(page_index, page));
-        return * page;
     }
 
 };
 
+template <typename header_t, typename size_t, size_t page_size, typename _page_t, size_t pages_max_count>
+const size_t FilePager<header_t, size_t, page_size, _page_t, pages_max_count>::readahead_min_run;
+template <typename header_t, typename size_t, size_t page_size, typename _page_t, size_t pages_max_count>
+const size_t FilePager<header_t, size_t, page_size, _page_t, pages_max_count>::readahead_max_pages;
+template <typename header_t, typename size_t, size_t page_size, typename _page_t, size_t pages_max_count>
+const size_t FilePager<header_t, size_t, page_size, _page_t, pages_max_count>::huge_page_size;
+
 
 #endif // __INCLUDED__File_hpp__
@@ -0,0 +1,379 @@
+#ifndef __INCLUDED__HashIndex_hpp__
+#define __INCLUDED__HashIndex_hpp__
+
+
+#include "DupaDB.hpp"
+#include "FilePager.hpp"
+#include "util/types.hpp"
+
+#include <functional>
+#include <vector>
+
+
+// File header for hash indices
+
+template <typename size_t, typename key_t, size_t _page_size>
+struct HashIndexHeader {
+
+    DupaHeader dupa;
+    char subtype[8];
+    uint32_t key_size;
+    uint32_t page_size;
+    uint32_t page_count;
+    // overflow pages freed by splits, chained through their `next` field
+    uint32_t first_free_page;
+    uint32_t overflow_pages_count;
+    uint64_t keys_count;
+    // linear hashing: there are 2^level buckets, plus the `split_bucket`
+    // ones that already got split in two at this level
+    uint32_t level;
+    size_t split_bucket;
+    // primary pages of the buckets of segment s, from 2^(s-1) to 2^s (bucket
+    // 0 being alone in segment 0), are consecutive
+    size_t segments[8 * sizeof(size_t) + 1];
+    bool must_initialize;
+
+    inline void set() {
+        dupa.set();
+        memcpy(subtype, "HASHIDX+", 8);
+        key_size = sizeof(key_t);
+        page_size = _page_size;
+        page_count = 0;
+        first_free_page = 0;
+        overflow_pages_count = 0;
+        keys_count = 0;
+        level = 0;
+        split_bucket = 0;
+        memset(segments, 0, sizeof(segments));
+        must_initialize = true;
+    }
+    inline const bool check() {
+        return
+            dupa.check() &&
+            !memcmp(subtype, "HASHIDX+", 8) &&
+            (key_size == sizeof(key_t)) &&
+            (page_size == _page_size);
+    }
+
+};
+
+
+// Bucket pages: entries keep the hash of their key, so that most mismatches
+// are told apart without comparing keys, and splits need no hashing. Pages of
+// a bucket are chained through `next`, the first one being its primary page.
+
+template <typename size_t, typename key_t, size_t page_size>
+struct HashIndexPage {
+
+    struct header_t {
+        uint16_t entries_count;
+        size_t next;
+    };
+    struct entry_t {
+        size_t hash;
+        key_t key;
+        size_t value;
+    };
+
+    static const size_t capacity = (page_size - sizeof(header_t)) / sizeof(entry_t);
+
+    header_t header;
+    entry_t entries[capacity];
+
+};
+
+template <typename size_t, typename key_t, size_t page_size>
+const size_t HashIndexPage<size_t, key_t, page_size>::capacity;
+
+
+// Hash index for equality lookups, with linear hashing: once the index gets
+// loaded enough, a single bucket gets split, so that it grows one page at a
+// time instead of being rehashed at once. A lookup reads the primary page of
+// its bucket, plus its overflow pages if any. Duplicate keys are kept. Not
+// meant for concurrent use.
+
+template <
+    typename size_t, typename key_t,
+    size_t reserve_size=1024*1024,
+    size_t page_size=4096, size_t pages_max_count=256,
+    typename hash_t=std::hash<key_t>
+>
+struct HashIndex : FilePager<HashIndexHeader<size_t, key_t, page_size>, size_t, page_size, HashIndexPage<size_t, key_t, page_size>, pages_max_count> {
+
+    typedef HashIndexPage<size_t, key_t, page_size> page_t;
+    typedef typename page_t::entry_t entry_t;
+
+    // splits happen above this many entries per bucket page, in percents
+    static const size_t max_load = 80;
+
+    inline HashIndex(const char* file_path, const int flags=0) :
+        FilePager<
+            HashIndexHeader<size_t, key_t, page_size>, size_t,
+            page_size, HashIndexPage<size_t, key_t, page_size>, pages_max_count
+        >(file_path, reserve_size, flags)
+    {
+        if (page_t::capacity == 0) {
+            fatal("keys of %lu bytes are too large for pages of %lu bytes", (uint64_t)sizeof(key_t), (uint64_t)page_size);
+        }
+        if (this->header->must_initialize) {
+            this->header->segments[0] = this->header->page_count++;
+            clear_page(0);
+            this->header->must_initialize = false;
+        }
+    }
+
+    // buckets are told apart by the lowest bits, which get mixed with the
+    // others first
+    static inline const size_t hash(const key_t& key) {
+        uint64_t hash = hash_t()(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        hash *= 0xc4ceb9fe1a85ec53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+    // not `size`, which is the size of the file
+    inline const uint64_t keys_count() const {
+        return this->header->keys_count;
+    }
+    inline const size_t buckets_count() const {
+        return ((size_t) 1 << this->header->level) + this->header->split_bucket;
+    }
+
+    // buckets
+    inline const size_t bucket(const size_t hash) const {
+        const size_t bucket = hash & (((size_t) 1 << this->header->level) - 1);
+        if (bucket < this->header->split_bucket) {
+            return hash & (((size_t) 2 << this->header->level) - 1);
+        }
+        return bucket;
+    }
+    inline const size_t bucket_page(const size_t bucket) const {
+        if (bucket == 0) {
+            return this->header->segments[0];
+        }
+        const size_t segment = 8 * sizeof(unsigned long long) - __builtin_clzll(bucket);
+        return this->header->segments[segment] + bucket - ((size_t) 1 << (segment - 1));
+    }
+    inline void clear_page(const size_t page_index) {
+        page_t& page = this->get_page(page_index);
+        page.header.entries_count = 0;
+        page.header.next = 0;
+    }
+    inline const size_t new_overflow_page() {
+        size_t page_index = this->header->first_free_page;
+        if (page_index) {
+            this->header->first_free_page = this->read_page(page_index).header.next;
+        } else {
+            page_index = this->header->page_count++;
+        }
+        this->header->overflow_pages_count++;
+        clear_page(page_index);
+        return page_index;
+    }
+    inline void release_overflow_page(const size_t page_index) {
+        this->get_page(page_index).header.next = this->header->first_free_page;
+        this->header->first_free_page = page_index;
+        this->header->overflow_pages_count--;
+    }
+    // in the first page of the chain with room left
+    inline void append(size_t page_index, const entry_t& entry) {
+        while (true) {
+            page_t& page = this->get_page(page_index);
+            if (page.header.entries_count < page_t::capacity) {
+                page.entries[page.header.entries_count++] = entry;
+                return;
+            }
+            if (page.header.next == 0) {
+                const size_t next_index = new_overflow_page();
+                this->get_page(page_index).header.next = next_index;
+            }
+            page_index = this->read_page(page_index).header.next;
+        }
+    }
+
+    // insertion, followed by a split when the index gets too loaded
+    inline void insert(const key_t& key, const size_t value) {
+        entry_t entry;
+        entry.hash = hash(key);
+        entry.key = key;
+        entry.value = value;
+        append(bucket_page(bucket(entry.hash)), entry);
+        this->header->keys_count++;
+        if (100 * this->header->keys_count > max_load * page_t::capacity * buckets_count()) {
+            split();
+        }
+    }
+    // entries of the next bucket to split get shared with a new one, at the
+    // end of the table
+    inline void split() {
+        const size_t level_size = (size_t) 1 << this->header->level;
+        const size_t old_bucket = this->header->split_bucket;
+        const size_t new_bucket = old_bucket + level_size;
+        // the first bucket of a segment reserves pages for all of them
+        if (new_bucket == level_size) {
+            this->header->segments[this->header->level + 1] = this->header->page_count;
+            this->header->page_count += level_size;
+        }
+        std::vector<entry_t> entries;
+        const size_t primary_index = bucket_page(old_bucket);
+        for (size_t page_index=primary_index; ; ) {
+            const page_t& page = this->read_page(page_index);
+            entries.insert(entries.end(), page.entries, page.entries + page.header.entries_count);
+            const size_t next_index = page.header.next;
+            if (page_index != primary_index) {
+                release_overflow_page(page_index);
+            }
+            page_index = next_index;
+            if (page_index == 0) {
+                break;
+            }
+        }
+        clear_page(bucket_page(old_bucket));
+        clear_page(bucket_page(new_bucket));
+        for (size_t e=0; e<entries.size(); e++) {
+            const bool is_moved = entries[e].hash & level_size;
+            append(bucket_page(is_moved ? new_bucket : old_bucket), entries[e]);
+        }
+        if (++this->header->split_bucket == level_size) {
+            this->header->level++;
+            this->header->split_bucket = 0;
+        }
+    }
+
+    // lookup of the first value for `key`, or of all of them, while
+    // `callback(value)` returns true; returns the number of visited values
+    inline const bool find(const key_t& key, size_t& value) {
+        size_t count = find(key, [&value](const size_t found_value) {
+            value = found_value;
+            return false;
+        });
+        return count != 0;
+    }
+    template <typename callback_t>
+    inline const size_t find(const key_t& key, callback_t callback) {
+        const size_t key_hash = hash(key);
+        size_t count = 0;
+        for (size_t page_index=bucket_page(bucket(key_hash)); ; ) {
+            const page_t& page = this->read_page(page_index);
+            for (size_t e=0; e<page.header.entries_count; e++) {
+                const entry_t& entry = page.entries[e];
+                if (entry.hash == key_hash && entry.key == key) {
+                    count++;
+                    if (!callback(entry.value)) {
+                        return count;
+                    }
+                }
+            }
+            // overflow pages are never page 0, which is bucket 0's
+            page_index = page.header.next;
+            if (page_index == 0) {
+                break;
+            }
+        }
+        return count;
+    }
+    inline const bool contains(const key_t& key) {
+        size_t value;
+        return find(key, value);
+    }
+
+    // removal of an entry with `key` (and `value`, when matching it); the
+    // last entry of its page takes its place, and emptied overflow pages
+    // leave the chain
+    inline const bool erase(const key_t& key) {
+        return erase(key, 0, false);
+    }
+    inline const bool erase(const key_t& key, const size_t value, const bool match_value=true) {
+        const size_t key_hash = hash(key);
+        size_t previous_index = 0;
+        for (size_t page_index=bucket_page(bucket(key_hash)); ; ) {
+            const page_t& page = this->read_page(page_index);
+            for (size_t e=0; e<page.header.entries_count; e++) {
+                const entry_t& entry = page.entries[e];
+                if (entry.hash != key_hash || !(entry.key == key) || (match_value && entry.value != value)) {
+                    continue;
+                }
+                page_t& written_page = this->get_page(page_index);
+                written_page.entries[e] = written_page.entries[--written_page.header.entries_count];
+                if (written_page.header.entries_count == 0 && previous_index) {
+                    const size_t next_index = written_page.header.next;
+                    this->get_page(previous_index).header.next = next_index;
+                    release_overflow_page(page_index);
+                }
+                this->header->keys_count--;
+                return true;
+            }
+            previous_index = page_index;
+            page_index = page.header.next;
+            if (page_index == 0) {
+                return false;
+            }
+        }
+    }
+
+    // every entry, bucket after bucket; stops early when
+    // `callback(key, value)` returns false, and returns the number of
+    // visited entries
+    template <typename callback_t>
+    inline const size_t scan(callback_t callback) {
+        size_t count = 0;
+        const size_t buckets_count = this->buckets_count();
+        for (size_t b=0; b<buckets_count; b++) {
+            for (size_t page_index=bucket_page(b); ; ) {
+                const page_t& page = this->read_page(page_index);
+                for (size_t e=0; e<page.header.entries_count; e++) {
+                    count++;
+                    if (!callback(page.entries[e].key, page.entries[e].value)) {
+                        return count;
+                    }
+                }
+                page_index = page.header.next;
+                if (page_index == 0) {
+                    break;
+                }
+            }
+        }
+        return count;
+    }
+
+    // consistency: entries lie in the bucket of their hash, and are counted
+    inline bool check() {
+        uint64_t count = 0;
+        const size_t buckets_count = this->buckets_count();
+        for (size_t b=0; b<buckets_count; b++) {
+            for (size_t page_index=bucket_page(b); ; ) {
+                const page_t& page = this->read_page(page_index);
+                if (page.header.entries_count > page_t::capacity) {
+                    error("page %lu has %u entries in: `%s`", (uint64_t)page_index, page.header.entries_count, this->_path.c_str());
+                    return false;
+                }
+                for (size_t e=0; e<page.header.entries_count; e++) {
+                    const entry_t& entry = page.entries[e];
+                    if (entry.hash != hash(entry.key) || bucket(entry.hash) != b) {
+                        error("misplaced entry in bucket %lu of: `%s`", (uint64_t)b, this->_path.c_str());
+                        return false;
+                    }
+                    count++;
+                }
+                page_index = page.header.next;
+                if (page_index == 0) {
+                    break;
+                }
+            }
+        }
+        if (count != this->header->keys_count) {
+            error("%lu entries found instead of %lu in: `%s`", count, this->header->keys_count, this->_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+};
+
+template <typename size_t, typename key_t, size_t reserve_size, size_t page_size, size_t pages_max_count, typename hash_t>
+const size_t HashIndex<size_t, key_t, reserve_size, page_size, pages_max_count, hash_t>::max_load;
+
+
+#endif // __INCLUDED__HashIndex_hpp__
@@ -0,0 +1,831 @@
+#ifndef __INCLUDED__RadixTree_hpp__
+#define __INCLUDED__RadixTree_hpp__
+
+
+#include "DupaDB.hpp"
+#include "FilePager.hpp"
+#include "util/types.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+// Nodes of adaptive radix trees: inner nodes come in four sizes, and grow or
+// shrink with the number of their children. They store their compressed path
+// (the bytes every key below them shares, past the byte leading to them), but
+// only up to `max_prefix_size` bytes of it; the rest is read from a leaf when
+// needed. Leaves hold whole keys, so that single keys need no inner node.
+
+template <typename size_t, uint32_t key_size>
+struct RadixTreeNodes {
+
+    enum type_t : uint8_t {
+        NODE4 = 0,
+        NODE16 = 1,
+        NODE48 = 2,
+        NODE256 = 3,
+    };
+
+    static const size_t max_prefix_size = 8;
+
+    struct node_t {
+        uint8_t type;
+        uint16_t children_count;
+        uint32_t prefix_size;
+        uint8_t prefix[max_prefix_size];
+    };
+    // sorted child bytes
+    struct node4_t : node_t {
+        uint8_t keys[4];
+        size_t children[4];
+    };
+    struct node16_t : node_t {
+        uint8_t keys[16];
+        size_t children[16];
+    };
+    // child position plus one for every byte, or 0
+    struct node48_t : node_t {
+        uint8_t child_slots[256];
+        size_t children[48];
+    };
+    struct node256_t : node_t {
+        size_t children[256];
+    };
+    // followed by the key itself; leaves holding the same key are chained
+    // through `next`, in insertion order
+    struct leaf_t {
+        size_t value;
+        size_t next;
+        uint16_t size;
+    };
+
+    // allocation classes: one per inner node type, then leaves by steps of
+    // `leaf_step` bytes
+    static const size_t leaf_step = 16;
+    static const size_t classes_count = 4 + (sizeof(leaf_t) + key_size + leaf_step - 1) / leaf_step;
+
+    static inline const size_t capacity(const size_t type) {
+        return (type == NODE4) ? 4 : (type == NODE16) ? 16 : (type == NODE48) ? 48 : 256;
+    }
+    // number of children below which nodes shrink, leaving some room before
+    // they would grow again
+    static inline const size_t shrink_size(const size_t type) {
+        return (type == NODE16) ? 3 : (type == NODE48) ? 12 : 37;
+    }
+    // rounded up, so that nodes stay aligned
+    static inline const size_t class_size(const size_t allocation_class) {
+        static const size_t sizes[] = {
+            (sizeof(node4_t) + 7) & ~(size_t)7,
+            (sizeof(node16_t) + 7) & ~(size_t)7,
+            (sizeof(node48_t) + 7) & ~(size_t)7,
+            (sizeof(node256_t) + 7) & ~(size_t)7,
+        };
+        return (allocation_class < 4) ? sizes[allocation_class] : (allocation_class - 3) * leaf_step;
+    }
+    static inline const size_t leaf_class(const size_t size) {
+        return 4 + (sizeof(leaf_t) + size - 1) / leaf_step;
+    }
+
+};
+
+template <typename size_t, uint32_t key_size>
+const size_t RadixTreeNodes<size_t, key_size>::max_prefix_size;
+template <typename size_t, uint32_t key_size>
+const size_t RadixTreeNodes<size_t, key_size>::leaf_step;
+template <typename size_t, uint32_t key_size>
+const size_t RadixTreeNodes<size_t, key_size>::classes_count;
+
+
+// File header for radix trees
+
+template <typename size_t, uint32_t _key_size, size_t _page_size, size_t classes_count>
+struct RadixTreeHeader {
+
+    DupaHeader dupa;
+    char subtype[8];
+    uint32_t key_size;
+    uint32_t page_size;
+    uint32_t page_count;
+    uint64_t keys_count;
+    size_t root;
+    // freed nodes of each class, chained through their first bytes
+    size_t free_nodes[classes_count];
+    // where the next node of each class gets carved, in the page the class
+    // currently uses
+    size_t next_nodes[classes_count];
+
+    inline void set() {
+        dupa.set();
+        memcpy(subtype, "RADIXTR+", 8);
+        key_size = _key_size;
+        page_size = _page_size;
+        // page 0 is never used, so that 0 is the null reference
+        page_count = 1;
+        keys_count = 0;
+        root = 0;
+        memset(free_nodes, 0, sizeof(free_nodes));
+        memset(next_nodes, 0, sizeof(next_nodes));
+    }
+    inline const bool check() {
+        return
+            dupa.check() &&
+            !memcmp(subtype, "RADIXTR+", 8) &&
+            (key_size == _key_size) &&
+            (page_size == _page_size);
+    }
+
+};
+
+
+template <typename size_t, size_t page_size>
+struct RadixTreePage {
+    char data[page_size];
+};
+
+
+// Adaptive radix tree for `str_t` keys, stored in pages: every page is carved
+// into nodes of a single class. Nodes are referenced by their offset in the
+// pages, leaves having their lowest bit set. Lookups take as many steps as
+// keys have distinct leading bytes, whatever the number of keys; duplicate
+// keys are kept, after the ones already there, and keys get visited in the
+// same order as in BTree. Not meant for concurrent use.
+
+template <
+    typename size_t, uint32_t key_size=256,
+    size_t reserve_size=1024*1024,
+    size_t page_size=4096, size_t pages_max_count=256
+>
+struct RadixTree : FilePager<RadixTreeHeader<size_t, key_size, page_size, RadixTreeNodes<size_t, key_size>::classes_count>, size_t, page_size, RadixTreePage<size_t, page_size>, pages_max_count> {
+
+    typedef str_t<key_size> key_t;
+    typedef RadixTreeNodes<size_t, key_size> nodes_t;
+    typedef typename nodes_t::node_t node_t;
+    typedef typename nodes_t::node4_t node4_t;
+    typedef typename nodes_t::node16_t node16_t;
+    typedef typename nodes_t::node48_t node48_t;
+    typedef typename nodes_t::node256_t node256_t;
+    typedef typename nodes_t::leaf_t leaf_t;
+
+    inline RadixTree(const char* file_path, const int flags=0) :
+        FilePager<
+            RadixTreeHeader<size_t, key_size, page_size, nodes_t::classes_count>, size_t,
+            page_size, RadixTreePage<size_t, page_size>, pages_max_count
+        >(file_path, reserve_size, flags)
+    {
+        if (nodes_t::class_size(nodes_t::NODE256) > page_size || nodes_t::class_size(nodes_t::classes_count - 1) > page_size) {
+            fatal("nodes are too large for pages of %lu bytes", (uint64_t)page_size);
+        }
+    }
+
+    // keys include their terminating null byte, so that none of them is the
+    // prefix of another one
+    static inline const size_t length(const key_t& key) {
+        return std::min<size_t>(key.length() + 1, key_size);
+    }
+    // not `size`, which is the size of the file
+    inline const uint64_t keys_count() const {
+        return this->header->keys_count;
+    }
+
+    // nodes
+    static inline const bool is_leaf(const size_t ref) {
+        return ref & 1;
+    }
+    inline char* write_ref(const size_t ref) {
+        return this->get_page(ref / page_size).data + (ref & ~(size_t)1) % page_size;
+    }
+    inline const char* read_ref(const size_t ref) {
+        return this->read_page(ref / page_size).data + (ref & ~(size_t)1) % page_size;
+    }
+    inline node_t* write_node(const size_t ref) {
+        return (node_t*) write_ref(ref);
+    }
+    inline const node_t* read_node(const size_t ref) {
+        return (const node_t*) read_ref(ref);
+    }
+    inline const leaf_t* read_leaf(const size_t ref) {
+        return (const leaf_t*) read_ref(ref);
+    }
+    static inline const uint8_t* leaf_key(const leaf_t* leaf) {
+        return (const uint8_t*) (leaf + 1);
+    }
+
+    // allocation
+    inline const size_t allocate(const size_t allocation_class) {
+        size_t ref = this->header->free_nodes[allocation_class];
+        if (ref) {
+            this->header->free_nodes[allocation_class] = * (const size_t*) read_ref(ref);
+            return ref;
+        }
+        const size_t node_size = nodes_t::class_size(allocation_class);
+        ref = this->header->next_nodes[allocation_class];
+        if (ref % page_size == 0 || ref % page_size + node_size > page_size) {
+            ref = (size_t) this->header->page_count++ * page_size;
+        }
+        this->header->next_nodes[allocation_class] = ref + node_size;
+        return ref;
+    }
+    inline void release(const size_t ref, const size_t allocation_class) {
+        * (size_t*) write_ref(ref) = this->header->free_nodes[allocation_class];
+        this->header->free_nodes[allocation_class] = ref & ~(size_t)1;
+    }
+    inline const size_t new_leaf(const uint8_t* key, const size_t size, const size_t value) {
+        const size_t ref = allocate(nodes_t::leaf_class(size));
+        leaf_t* leaf = (leaf_t*) write_ref(ref);
+        leaf->value = value;
+        leaf->next = 0;
+        leaf->size = size;
+        memcpy(leaf + 1, key, size);
+        return ref | 1;
+    }
+    inline const size_t new_node(const uint8_t type, const uint8_t* prefix, const size_t prefix_size) {
+        const size_t ref = allocate(type);
+        node_t* node = write_node(ref);
+        memset(node, 0, nodes_t::class_size(type));
+        node->type = type;
+        node->prefix_size = prefix_size;
+        memcpy(node->prefix, prefix, std::min(prefix_size, nodes_t::max_prefix_size));
+        return ref;
+    }
+
+    // children
+    static inline size_t* child_ref(node_t* node, const uint8_t byte) {
+        switch (node->type) {
+            case nodes_t::NODE4: {
+                node4_t* node4 = (node4_t*) node;
+                for (size_t i=0; i<node->children_count; i++) {
+                    if (node4->keys[i] == byte) {
+                        return node4->children + i;
+                    }
+                }
+                return NULL;
+            }
+            case nodes_t::NODE16: {
+                node16_t* node16 = (node16_t*) node;
+#if defined(__SSE2__)
+                const __m128i keys = _mm_loadu_si128((const __m128i*) node16->keys);
+                const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8(byte))) & ((1u << node->children_count) - 1);
+                return mask ? node16->children + __builtin_ctz(mask) : NULL;
+#else
+                for (size_t i=0; i<node->children_count; i++) {
+                    if (node16->keys[i] == byte) {
+                        return node16->children + i;
+                    }
+                }
+                return NULL;
+#endif
+            }
+            case nodes_t::NODE48: {
+                node48_t* node48 = (node48_t*) node;
+                const uint8_t slot = node48->child_slots[byte];
+                return slot ? node48->children + slot - 1 : NULL;
+            }
+            default: {
+                node256_t* node256 = (node256_t*) node;
+                return node256->children[byte] ? node256->children + byte : NULL;
+            }
+        }
+    }
+    static inline const size_t find_child(const node_t* node, const uint8_t byte) {
+        const size_t* ref = child_ref((node_t*) node, byte);
+        return ref ? *ref : 0;
+    }
+    // the node should have room left
+    static inline void add_child(node_t* node, const uint8_t byte, const size_t child) {
+        switch (node->type) {
+            case nodes_t::NODE4:
+            case nodes_t::NODE16: {
+                uint8_t* keys = (node->type == nodes_t::NODE4) ? ((node4_t*) node)->keys : ((node16_t*) node)->keys;
+                size_t* children = (node->type == nodes_t::NODE4) ? ((node4_t*) node)->children : ((node16_t*) node)->children;
+                size_t i = node->children_count;
+                while (i && keys[i - 1] > byte) {
+                    keys[i] = keys[i - 1];
+                    children[i] = children[i - 1];
+                    i--;
+                }
+                keys[i] = byte;
+                children[i] = child;
+                break;
+            }
+            case nodes_t::NODE48: {
+                // children stay packed, see `remove_child`
+                node48_t* node48 = (node48_t*) node;
+                node48->children[node->children_count] = child;
+                node48->child_slots[byte] = node->children_count + 1;
+                break;
+            }
+            default:
+                ((node256_t*) node)->children[byte] = child;
+        }
+        node->children_count++;
+    }
+    static inline void remove_child(node_t* node, const uint8_t byte) {
+        switch (node->type) {
+            case nodes_t::NODE4:
+            case nodes_t::NODE16: {
+                uint8_t* keys = (node->type == nodes_t::NODE4) ? ((node4_t*) node)->keys : ((node16_t*) node)->keys;
+                size_t* children = (node->type == nodes_t::NODE4) ? ((node4_t*) node)->children : ((node16_t*) node)->children;
+                size_t i = 0;
+                while (keys[i] != byte) {
+                    i++;
+                }
+                for (; i + 1 < node->children_count; i++) {
+                    keys[i] = keys[i + 1];
+                    children[i] = children[i + 1];
+                }
+                break;
+            }
+            case nodes_t::NODE48: {
+                // the last child fills the hole
+                node48_t* node48 = (node48_t*) node;
+                const uint8_t slot = node48->child_slots[byte];
+                node48->child_slots[byte] = 0;
+                if (slot != node->children_count) {
+                    node48->children[slot - 1] = node48->children[node->children_count - 1];
+                    for (size_t b=0; b<256; b++) {
+                        if (node48->child_slots[b] == node->children_count) {
+                            node48->child_slots[b] = slot;
+                            break;
+                        }
+                    }
+                }
+                break;
+            }
+            default:
+                ((node256_t*) node)->children[byte] = 0;
+        }
+        node->children_count--;
+    }
+    // children in the order of their bytes; returns their number
+    static inline const size_t children(const node_t* node, uint8_t* bytes, size_t* refs) {
+        size_t count = 0;
+        switch (node->type) {
+            case nodes_t::NODE4:
+            case nodes_t::NODE16: {
+                const uint8_t* keys = (node->type == nodes_t::NODE4) ? ((const node4_t*) node)->keys : ((const node16_t*) node)->keys;
+                const size_t* children = (node->type == nodes_t::NODE4) ? ((const node4_t*) node)->children : ((const node16_t*) node)->children;
+                for (; count<node->children_count; count++) {
+                    bytes[count] = keys[count];
+                    refs[count] = children[count];
+                }
+                break;
+            }
+            case nodes_t::NODE48: {
+                const node48_t* node48 = (const node48_t*) node;
+                for (size_t b=0; b<256; b++) {
+                    if (node48->child_slots[b]) {
+                        bytes[count] = b;
+                        refs[count++] = node48->children[node48->child_slots[b] - 1];
+                    }
+                }
+                break;
+            }
+            default: {
+                const node256_t* node256 = (const node256_t*) node;
+                for (size_t b=0; b<256; b++) {
+                    if (node256->children[b]) {
+                        bytes[count] = b;
+                        refs[count++] = node256->children[b];
+                    }
+                }
+            }
+        }
+        return count;
+    }
+    // copy of the node with another type, replacing it
+    inline const size_t resize(const size_t ref, const uint8_t type) {
+        uint8_t bytes[256];
+        size_t refs[256];
+        const node_t* node = read_node(ref);
+        const node_t header = *node;
+        const size_t count = children(node, bytes, refs);
+        release(ref, header.type);
+        const size_t resized_ref = new_node(type, header.prefix, header.prefix_size);
+        node_t* resized = write_node(resized_ref);
+        for (size_t c=0; c<count; c++) {
+            add_child(resized, bytes[c], refs[c]);
+        }
+        return resized_ref;
+    }
+    // `parent` being 0 for the root
+    inline void replace_child(const size_t parent, const uint8_t byte, const size_t child) {
+        if (parent == 0) {
+            this->header->root = child;
+            return;
+        }
+        * child_ref(write_node(parent), byte) = child;
+    }
+    // the whole compressed path of a node found at `depth`, possibly read
+    // from its first leaf
+    inline void load_prefix(size_t ref, const size_t depth, uint8_t* prefix) {
+        const node_t* node = read_node(ref);
+        const size_t prefix_size = node->prefix_size;
+        if (prefix_size <= nodes_t::max_prefix_size) {
+            memcpy(prefix, node->prefix, prefix_size);
+            return;
+        }
+        while (!is_leaf(ref)) {
+            uint8_t bytes[256];
+            size_t refs[256];
+            children(read_node(ref), bytes, refs);
+            ref = refs[0];
+        }
+        memcpy(prefix, leaf_key(read_leaf(ref)) + depth, prefix_size);
+    }
+
+    // insertion; duplicate keys go after the ones already there
+    inline const bool insert(const key_t& key, const size_t value) {
+        const uint8_t* k = (const uint8_t*) key.data();
+        const size_t size = length(key);
+        size_t parent = 0;
+        uint8_t parent_byte = 0;
+        size_t ref = this->header->root;
+        size_t depth = 0;
+        while (true) {
+            if (ref == 0) {
+                this->header->root = new_leaf(k, size, value);
+                this->header->keys_count++;
+                return true;
+            }
+            // lazy expansion: an inner node only gets created where two keys
+            // part
+            if (is_leaf(ref)) {
+                const leaf_t* leaf = read_leaf(ref);
+                if (leaf->size == size && !memcmp(leaf_key(leaf), k, size)) {
+                    size_t last = ref;
+                    while (read_leaf(last)->next) {
+                        last = read_leaf(last)->next;
+                    }
+                    const size_t leaf_ref = new_leaf(k, size, value);
+                    ((leaf_t*) write_ref(last))->next = leaf_ref;
+                    this->header->keys_count++;
+                    return true;
+                }
+                uint8_t other[key_size];
+                const size_t other_size = leaf->size;
+                memcpy(other, leaf_key(leaf), other_size);
+                size_t common = depth;
+                while (common < size && common < other_size && k[common] == other[common]) {
+                    common++;
+                }
+                if (common == size || common == other_size) {
+                    fatal("key `%s` is a prefix of another one in: `%s`", key.data(), this->_path.c_str());
+                }
+                const size_t leaf_ref = new_leaf(k, size, value);
+                const size_t node_ref = new_node(nodes_t::NODE4, k + depth, common - depth);
+                node_t* node = write_node(node_ref);
+                add_child(node, other[common], ref);
+                add_child(node, k[common], leaf_ref);
+                replace_child(parent, parent_byte, node_ref);
+                this->header->keys_count++;
+                return true;
+            }
+            // path compression: when the key leaves the compressed path, the
+            // node gets a new parent where they part
+            const node_t* node = read_node(ref);
+            const size_t prefix_size = node->prefix_size;
+            if (prefix_size) {
+                uint8_t prefix[key_size];
+                const size_t stored_size = std::min(prefix_size, nodes_t::max_prefix_size);
+                memcpy(prefix, node->prefix, stored_size);
+                size_t mismatch = 0;
+                while (mismatch < stored_size && depth + mismatch < size && prefix[mismatch] == k[depth + mismatch]) {
+                    mismatch++;
+                }
+                if (mismatch == stored_size && prefix_size > stored_size) {
+                    load_prefix(ref, depth, prefix);
+                    while (mismatch < prefix_size && depth + mismatch < size && prefix[mismatch] == k[depth + mismatch]) {
+                        mismatch++;
+                    }
+                } else if (mismatch < prefix_size && prefix_size > stored_size) {
+                    load_prefix(ref, depth, prefix);
+                }
+                if (mismatch < prefix_size) {
+                    if (depth + mismatch >= size) {
+                        fatal("key `%s` is a prefix of another one in: `%s`", key.data(), this->_path.c_str());
+                    }
+                    node_t* shortened = write_node(ref);
+                    shortened->prefix_size = prefix_size - mismatch - 1;
+                    memcpy(shortened->prefix, prefix + mismatch + 1, std::min<size_t>(shortened->prefix_size, nodes_t::max_prefix_size));
+                    const size_t leaf_ref = new_leaf(k, size, value);
+                    const size_t node_ref = new_node(nodes_t::NODE4, prefix, mismatch);
+                    node_t* split = write_node(node_ref);
+                    add_child(split, prefix[mismatch], ref);
+                    add_child(split, k[depth + mismatch], leaf_ref);
+                    replace_child(parent, parent_byte, node_ref);
+                    this->header->keys_count++;
+                    return true;
+                }
+                depth += prefix_size;
+                node = read_node(ref);
+            }
+            if (depth >= size) {
+                fatal("key `%s` is a prefix of another one in: `%s`", key.data(), this->_path.c_str());
+            }
+            const size_t child = find_child(node, k[depth]);
+            if (child == 0) {
+                const size_t leaf_ref = new_leaf(k, size, value);
+                node = read_node(ref);
+                if (node->children_count == nodes_t::capacity(node->type)) {
+                    const size_t grown_ref = resize(ref, node->type + 1);
+                    replace_child(parent, parent_byte, grown_ref);
+                    ref = grown_ref;
+                }
+                add_child(write_node(ref), k[depth], leaf_ref);
+                this->header->keys_count++;
+                return true;
+            }
+            parent = ref;
+            parent_byte = k[depth];
+            ref = child;
+            depth++;
+        }
+    }
+
+    // lookup of the first value for `key`, or of all of them, while
+    // `callback(value)` returns true; returns the number of visited values
+    inline const bool find(const key_t& key, size_t& value) {
+        size_t count = find(key, [&value](const size_t found_value) {
+            value = found_value;
+            return false;
+        });
+        return count != 0;
+    }
+    template <typename callback_t>
+    inline const size_t find(const key_t& key, callback_t callback) {
+        size_t count = 0;
+        for (size_t ref=find_leaf(key); ref; ) {
+            const leaf_t* leaf = read_leaf(ref);
+            const size_t value = leaf->value;
+            ref = leaf->next;
+            count++;
+            if (!callback(value)) {
+                break;
+            }
+        }
+        return count;
+    }
+    inline const bool contains(const key_t& key) {
+        return find_leaf(key) != 0;
+    }
+    // the first leaf holding `key`, or 0
+    inline const size_t find_leaf(const key_t& key) {
+        const uint8_t* k = (const uint8_t*) key.data();
+        const size_t size = length(key);
+        size_t ref = this->header->root;
+        size_t depth = 0;
+        while (ref) {
+            if (is_leaf(ref)) {
+                const leaf_t* leaf = read_leaf(ref);
+                return (leaf->size == size && !memcmp(leaf_key(leaf), k, size)) ? ref : 0;
+            }
+            const node_t* node = read_node(ref);
+            // bytes of the compressed path past the stored ones are skipped,
+            // the leaf tells whether they matched
+            if (node->prefix_size) {
+                const size_t stored_size = std::min<size_t>(node->prefix_size, nodes_t::max_prefix_size);
+                if (depth + stored_size > size || memcmp(node->prefix, k + depth, stored_size)) {
+                    return 0;
+                }
+                depth += node->prefix_size;
+            }
+            if (depth >= size) {
+                return 0;
+            }
+            ref = find_child(node, k[depth++]);
+        }
+        return 0;
+    }
+
+    // removal of the first entry with `key` (and `value`, when matching it);
+    // once a key has no entry left, inner nodes left with a single child get
+    // merged into it, and others shrink when they get sparse enough
+    inline const bool erase(const key_t& key) {
+        return erase(key, 0, false);
+    }
+    inline const bool erase(const key_t& key, const size_t value, const bool match_value=true) {
+        const uint8_t* k = (const uint8_t*) key.data();
+        const size_t size = length(key);
+        size_t grandparent = 0;
+        uint8_t grandparent_byte = 0;
+        size_t parent = 0;
+        uint8_t parent_byte = 0;
+        size_t ref = this->header->root;
+        size_t depth = 0;
+        while (true) {
+            if (ref == 0) {
+                return false;
+            }
+            if (is_leaf(ref)) {
+                const leaf_t* leaf = read_leaf(ref);
+                if (leaf->size != size || memcmp(leaf_key(leaf), k, size)) {
+                    return false;
+                }
+                break;
+            }
+            const node_t* node = read_node(ref);
+            if (node->prefix_size) {
+                const size_t stored_size = std::min<size_t>(node->prefix_size, nodes_t::max_prefix_size);
+                if (depth + stored_size > size || memcmp(node->prefix, k + depth, stored_size)) {
+                    return false;
+                }
+                depth += node->prefix_size;
+            }
+            if (depth >= size) {
+                return false;
+            }
+            grandparent = parent;
+            grandparent_byte = parent_byte;
+            parent = ref;
+            parent_byte = k[depth];
+            ref = find_child(node, k[depth++]);
+        }
+        size_t previous = 0;
+        size_t erased = ref;
+        while (match_value && read_leaf(erased)->value != value) {
+            previous = erased;
+            erased = read_leaf(erased)->next;
+            if (erased == 0) {
+                return false;
+            }
+        }
+        const size_t next = read_leaf(erased)->next;
+        release(erased, nodes_t::leaf_class(size));
+        this->header->keys_count--;
+        // other entries with the same key take its place
+        if (previous) {
+            ((leaf_t*) write_ref(previous))->next = next;
+            return true;
+        }
+        if (next) {
+            replace_child(parent, parent_byte, next);
+            return true;
+        }
+        if (parent == 0) {
+            this->header->root = 0;
+            return true;
+        }
+        node_t* node = write_node(parent);
+        remove_child(node, parent_byte);
+        const uint8_t type = node->type;
+        const size_t count = node->children_count;
+        if (type == nodes_t::NODE4 && count == 1) {
+            const node_t header = *node;
+            const uint8_t byte = ((node4_t*) node)->keys[0];
+            const size_t child = ((node4_t*) node)->children[0];
+            release(parent, nodes_t::NODE4);
+            if (!is_leaf(child)) {
+                // the child's compressed path gets longer
+                node_t* merged = write_node(child);
+                uint8_t prefix[2 * nodes_t::max_prefix_size + 1];
+                size_t prefix_size = std::min<size_t>(header.prefix_size, nodes_t::max_prefix_size);
+                memcpy(prefix, header.prefix, prefix_size);
+                prefix[prefix_size++] = byte;
+                memcpy(prefix + prefix_size, merged->prefix, std::min<size_t>(merged->prefix_size, nodes_t::max_prefix_size));
+                merged->prefix_size += header.prefix_size + 1;
+                memcpy(merged->prefix, prefix, std::min<size_t>(merged->prefix_size, nodes_t::max_prefix_size));
+            }
+            replace_child(grandparent, grandparent_byte, child);
+        } else if (type > nodes_t::NODE4 && count <= nodes_t::shrink_size(type)) {
+            replace_child(grandparent, grandparent_byte, resize(parent, type - 1));
+        }
+        return true;
+    }
+
+    // keys starting with `prefix`, in order; stops early when
+    // `callback(key, value)` returns false, and returns the number of
+    // visited keys
+    template <typename callback_t>
+    inline const size_t scan(callback_t callback) {
+        return scan(key_t(), callback);
+    }
+    template <typename callback_t>
+    inline const size_t scan(const key_t& prefix, callback_t callback) {
+        const uint8_t* p = (const uint8_t*) prefix.data();
+        const size_t size = prefix.length();
+        size_t ref = this->header->root;
+        size_t depth = 0;
+        while (ref && !is_leaf(ref) && depth < size) {
+            const node_t* node = read_node(ref);
+            const size_t compared_size = std::min<size_t>(std::min<size_t>(node->prefix_size, nodes_t::max_prefix_size), size - depth);
+            if (memcmp(node->prefix, p + depth, compared_size)) {
+                return 0;
+            }
+            depth += node->prefix_size;
+            if (depth >= size) {
+                break;
+            }
+            ref = find_child(node, p[depth++]);
+        }
+        size_t count = 0;
+        visit(ref, p, size, callback, count);
+        return count;
+    }
+    template <typename callback_t>
+    inline const bool visit(const size_t ref, const uint8_t* prefix, const size_t prefix_size, callback_t& callback, size_t& count) {
+        if (ref == 0) {
+            return true;
+        }
+        if (is_leaf(ref)) {
+            const leaf_t* leaf = read_leaf(ref);
+            if (leaf->size < prefix_size || memcmp(leaf_key(leaf), prefix, prefix_size)) {
+                return true;
+            }
+            key_t key;
+            memcpy(key._data, leaf_key(leaf), leaf->size);
+            for (size_t leaf_ref=ref; leaf_ref; ) {
+                leaf = read_leaf(leaf_ref);
+                const size_t value = leaf->value;
+                leaf_ref = leaf->next;
+                count++;
+                if (!callback(key, value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        uint8_t bytes[256];
+        size_t refs[256];
+        const size_t children_count = children(read_node(ref), bytes, refs);
+        for (size_t c=0; c<children_count; c++) {
+            if (!visit(refs[c], prefix, prefix_size, callback, count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // consistency: inner nodes have at least two children, fitting their
+    // type, leaves agree with the bytes leading to them, and duplicates with
+    // the first leaf of their chain
+    inline bool check() {
+        uint8_t path[key_size];
+        bool is_known[key_size];
+        uint64_t count = 0;
+        if (this->header->root && !check(this->header->root, 0, path, is_known, count)) {
+            return false;
+        }
+        if (count != this->header->keys_count) {
+            error("%lu keys found instead of %lu in: `%s`", count, this->header->keys_count, this->_path.c_str());
+            return false;
+        }
+        return true;
+    }
+    inline bool check(const size_t ref, size_t depth, uint8_t* path, bool* is_known, uint64_t& count) {
+        if (is_leaf(ref)) {
+            const leaf_t* leaf = read_leaf(ref);
+            for (size_t i=0; i<depth; i++) {
+                if (i >= leaf->size || (is_known[i] && leaf_key(leaf)[i] != path[i])) {
+                    error("misplaced key `%.*s` in: `%s`", (int)leaf->size, leaf_key(leaf), this->_path.c_str());
+                    return false;
+                }
+            }
+            uint8_t key[key_size];
+            const size_t size = leaf->size;
+            memcpy(key, leaf_key(leaf), size);
+            for (size_t leaf_ref=ref; leaf_ref; leaf_ref=leaf->next) {
+                leaf = read_leaf(leaf_ref);
+                if (!is_leaf(leaf_ref) || leaf->size != size || memcmp(leaf_key(leaf), key, size)) {
+                    error("invalid duplicate of `%.*s` at %lu in: `%s`", (int)size, key, (uint64_t)leaf_ref, this->_path.c_str());
+                    return false;
+                }
+                count++;
+            }
+            return true;
+        }
+        const node_t* node = read_node(ref);
+        const size_t type = node->type;
+        const size_t prefix_size = node->prefix_size;
+        if (type > nodes_t::NODE256 || node->children_count < 2 || node->children_count > nodes_t::capacity(type) || depth + prefix_size >= key_size) {
+            error("invalid node at %lu in: `%s`", (uint64_t)ref, this->_path.c_str());
+            return false;
+        }
+        for (size_t i=0; i<prefix_size; i++) {
+            path[depth + i] = (i < nodes_t::max_prefix_size) ? node->prefix[i] : 0;
+            is_known[depth + i] = (i < nodes_t::max_prefix_size);
+        }
+        depth += prefix_size;
+        uint8_t bytes[256];
+        size_t refs[256];
+        const size_t children_count = children(node, bytes, refs);
+        if (children_count != node->children_count) {
+            error("node at %lu has %lu children instead of %u in: `%s`", (uint64_t)ref, (uint64_t)children_count, node->children_count, this->_path.c_str());
+            return false;
+        }
+        for (size_t c=0; c<children_count; c++) {
+            path[depth] = bytes[c];
+            is_known[depth] = true;
+            if ((c && bytes[c] <= bytes[c - 1]) || !check(refs[c], depth + 1, path, is_known, count)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+
+#endif // __INCLUDED__RadixTree_hpp__
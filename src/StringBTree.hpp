@@ -0,0 +1,774 @@
+#ifndef __INCLUDED__StringBTree_hpp__
+#define __INCLUDED__StringBTree_hpp__
+
+
+#include "DupaDB.hpp"
+#include "FilePager.hpp"
+#include "util/types.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// File header for string B-trees
+
+template <typename size_t, uint32_t _key_size, size_t _page_size>
+struct StringBTreeHeader {
+
+    DupaHeader dupa;
+    char subtype[8];
+    uint32_t key_size;
+    uint32_t page_size;
+    uint32_t page_count;
+    // freed overflow pages, chained through their `next` field
+    uint32_t first_free_page;
+    uint32_t overflow_pages_count;
+    bool must_initialize;
+
+    inline void set() {
+        dupa.set();
+        memcpy(subtype, "STRDBTR+", 8);
+        key_size = _key_size;
+        page_size = _page_size;
+        page_count = 0;
+        first_free_page = 0;
+        overflow_pages_count = 0;
+        must_initialize = true;
+    }
+    inline const bool check() {
+        return
+            dupa.check() &&
+            !memcmp(subtype, "STRDBTR+", 8) &&
+            (key_size == _key_size) &&
+            (page_size == _page_size);
+    }
+
+};
+
+
+// Slotted pages for string keys: slots (position and size of the key, value)
+// grow from the beginning of the page, keys from its end. The prefix common
+// to every key of a page is stored only once, at the very end, and compared
+// only once per search. In internal pages, the value of a key is the child
+// right of it, `first_child` being the leftmost one.
+// Keys too long to take less than an eighth of a page are copied whole into
+// a chain of overflow pages; only their first bytes stay in the slotted page,
+// followed by the location and size of the chain, so most comparisons are
+// decided without reading it.
+
+template <typename size_t, size_t page_size>
+struct StringBTreePage {
+
+    typedef StringBTreePage<size_t, page_size> page_t;
+
+    struct header_t {
+        bool is_leaf;
+        uint16_t keys_count;
+        uint16_t prefix_size;
+        // keys are stored from `heap_begin` to the prefix
+        uint16_t heap_begin;
+        // room left by erased keys, reclaimed when rebuilding
+        uint16_t garbage_size;
+        uint16_t overflow_keys_count;
+        size_t index;
+        size_t prev;
+        size_t next;
+        size_t first_child;
+    };
+    struct slot_t {
+        uint16_t offset;
+        // with `overflow_flag` set for keys in overflow pages
+        uint16_t size;
+        size_t value;
+    };
+    // stored after the first bytes of keys in overflow pages
+    struct overflow_t {
+        size_t first_page;
+        uint32_t size;
+    };
+    // entries, when pages get rebuilt
+    struct entry_t {
+        std::string key;
+        size_t value;
+        // first overflow page of the key, if any
+        size_t overflow;
+
+        inline entry_t(const std::string& key, const size_t value, const size_t overflow=0) : key(key), value(value), overflow(overflow) {}
+    };
+
+    static const size_t data_size = page_size - sizeof(header_t);
+    static const uint16_t overflow_flag = 0x8000;
+    // longer keys go to overflow pages
+    static const size_t inline_size_max = data_size / 8 - sizeof(slot_t);
+    // bytes of these keys that stay in the page, after its prefix, which is
+    // kept short enough for them to be there
+    static const size_t overflow_inline_size = 64;
+    static const size_t prefix_size_max = inline_size_max - overflow_inline_size;
+
+    header_t header;
+    char data[data_size];
+
+    inline slot_t* slots() {
+        return (slot_t*) data;
+    }
+    inline const slot_t* slots() const {
+        return (const slot_t*) data;
+    }
+    inline const char* prefix() const {
+        return data + data_size - header.prefix_size;
+    }
+    inline const size_t free_size() const {
+        return header.heap_begin - header.keys_count * sizeof(slot_t);
+    }
+
+    // keys and values; keys in overflow pages have to be read from there
+    inline const bool is_overflow(const size_t index) const {
+        return slots()[index].size & overflow_flag;
+    }
+    inline const overflow_t overflow(const size_t index) const {
+        overflow_t result;
+        memcpy(&result, data + slots()[index].offset + overflow_inline_size, sizeof(overflow_t));
+        return result;
+    }
+    inline const size_t stored_size(const size_t index) const {
+        return slots()[index].size & ~overflow_flag;
+    }
+    inline const size_t key_size(const size_t index) const {
+        return is_overflow(index) ? overflow(index).size : header.prefix_size + slots()[index].size;
+    }
+    inline void get_key(const size_t index, char* key) const {
+        memcpy(key, prefix(), header.prefix_size);
+        memcpy(key + header.prefix_size, data + slots()[index].offset, slots()[index].size);
+    }
+    inline const size_t value(const size_t index) const {
+        return slots()[index].value;
+    }
+    // internal pages: child at `index`, from 0 to `keys_count`
+    inline const size_t child(const size_t index) const {
+        return index ? slots()[index - 1].value : header.first_child;
+    }
+
+    // comparison of `key`, without the prefix, with the key at `index`;
+    // `chains.compare_overflow` takes over past the bytes stored in the page
+    template <typename chains_t>
+    inline const int compare(const size_t index, const char* key, const size_t size, chains_t& chains) const {
+        const slot_t& slot = slots()[index];
+        if (!(slot.size & overflow_flag)) {
+            const int comparison = memcmp(key, data + slot.offset, std::min<size_t>(size, slot.size));
+            return comparison ? comparison : (size > slot.size) - (size < slot.size);
+        }
+        const int comparison = memcmp(key, data + slot.offset, std::min(size, overflow_inline_size));
+        if (comparison || size <= overflow_inline_size) {
+            // stored keys are longer than their part in the page
+            return comparison ? comparison : -1;
+        }
+        const overflow_t chain = overflow(index);
+        return chains.compare_overflow(chain.first_page, chain.size, header.prefix_size + overflow_inline_size, key + overflow_inline_size, size - overflow_inline_size);
+    }
+
+    // number of keys lower than `key`, or lower or equal when `is_upper`
+    template <typename chains_t>
+    inline const size_t search(const char* key, size_t size, const bool is_upper, chains_t& chains) const {
+        const size_t prefix_size = header.prefix_size;
+        const int prefix_comparison = memcmp(key, prefix(), std::min(size, prefix_size));
+        if (prefix_comparison < 0 || (prefix_comparison == 0 && size < prefix_size)) {
+            return 0;
+        }
+        if (prefix_comparison > 0) {
+            return header.keys_count;
+        }
+        key += prefix_size;
+        size -= prefix_size;
+        size_t lo = 0;
+        size_t hi = header.keys_count;
+        while (lo < hi) {
+            const size_t middle = (lo + hi) / 2;
+            const int comparison = compare(middle, key, size, chains);
+            if (comparison > 0 || (is_upper && comparison == 0)) {
+                lo = middle + 1;
+            } else {
+                hi = middle;
+            }
+        }
+        return lo;
+    }
+
+    // in place, `overflow` being the first overflow page of long keys; fails
+    // when the key does not start with the prefix, or when there is no room
+    // left for it
+    inline const bool insert(const size_t index, const char* key, const size_t size, const size_t value, const size_t overflow=0) {
+        const size_t prefix_size = header.prefix_size;
+        if (size < prefix_size || memcmp(key, prefix(), prefix_size)) {
+            return false;
+        }
+        const size_t suffix_size = overflow ? overflow_inline_size + sizeof(overflow_t) : size - prefix_size;
+        if (free_size() < sizeof(slot_t) + suffix_size) {
+            return false;
+        }
+        header.heap_begin -= suffix_size;
+        if (overflow) {
+            const overflow_t chain = {
+                .first_page = overflow,
+                .size = (uint32_t) size,
+            };
+            memcpy(data + header.heap_begin, key + prefix_size, overflow_inline_size);
+            memcpy(data + header.heap_begin + overflow_inline_size, &chain, sizeof(overflow_t));
+            header.overflow_keys_count++;
+        } else {
+            memcpy(data + header.heap_begin, key + prefix_size, suffix_size);
+        }
+        slot_t* s = slots();
+        memmove(s + index + 1, s + index, (header.keys_count - index) * sizeof(slot_t));
+        s[index] = {
+            .offset = header.heap_begin,
+            .size = (uint16_t) (overflow ? (suffix_size | overflow_flag) : suffix_size),
+            .value = value,
+        };
+        header.keys_count++;
+        return true;
+    }
+    // returns the first overflow page of the erased key, if any, so that
+    // the chain can be freed
+    inline const size_t erase(const size_t index) {
+        size_t overflow = 0;
+        if (is_overflow(index)) {
+            overflow = this->overflow(index).first_page;
+            header.overflow_keys_count--;
+        }
+        slot_t* s = slots();
+        header.garbage_size += stored_size(index);
+        memmove(s + index, s + index + 1, (header.keys_count - index - 1) * sizeof(slot_t));
+        header.keys_count--;
+        return overflow;
+    }
+
+    // rebuilding, with the longest prefix for the given entries; keys in
+    // overflow pages are left blank, with their size
+    inline void entries(std::vector<entry_t>& result) const {
+        for (size_t k=0; k<header.keys_count; k++) {
+            if (is_overflow(k)) {
+                const overflow_t chain = overflow(k);
+                result.push_back(entry_t(std::string(chain.size, 0), value(k), chain.first_page));
+            } else {
+                std::string key(key_size(k), 0);
+                get_key(k, &key[0]);
+                result.push_back(entry_t(key, value(k)));
+            }
+        }
+    }
+    static inline const size_t common_prefix_size(const std::string& a, const std::string& b) {
+        const size_t size = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i < size && a[i] == b[i]) {
+            i++;
+        }
+        return i;
+    }
+    // sorted entries from `begin` to `end` share the prefix of the first and
+    // last ones
+    static inline const size_t entries_prefix_size(const std::vector<entry_t>& entries, const size_t begin, const size_t end) {
+        if (begin == end) {
+            return 0;
+        }
+        return std::min(common_prefix_size(entries[begin].key, entries[end - 1].key), prefix_size_max);
+    }
+    static inline const size_t stored_size(const entry_t& entry, const size_t prefix_size) {
+        return sizeof(slot_t) + (entry.overflow ? overflow_inline_size + sizeof(overflow_t) : entry.key.size() - prefix_size);
+    }
+    static inline const bool fits(const std::vector<entry_t>& entries, const size_t begin, const size_t end) {
+        const size_t prefix_size = entries_prefix_size(entries, begin, end);
+        size_t size = prefix_size;
+        for (size_t e=begin; e<end; e++) {
+            size += stored_size(entries[e], prefix_size);
+        }
+        return size <= data_size;
+    }
+    inline void rebuild(const std::vector<entry_t>& entries, const size_t begin, const size_t end) {
+        const size_t prefix_size = entries_prefix_size(entries, begin, end);
+        header.keys_count = 0;
+        header.garbage_size = 0;
+        header.overflow_keys_count = 0;
+        header.prefix_size = prefix_size;
+        header.heap_begin = data_size - prefix_size;
+        if (prefix_size) {
+            memcpy(data + header.heap_begin, entries[begin].key.data(), prefix_size);
+        }
+        for (size_t e=begin; e<end; e++) {
+            if (!insert(header.keys_count, entries[e].key.data(), entries[e].key.size(), entries[e].value, entries[e].overflow)) {
+                fatal("could not rebuild page %lu with %lu entries", (uint64_t)header.index, (uint64_t)(end - begin));
+            }
+        }
+    }
+
+};
+
+template <typename size_t, size_t page_size>
+const size_t StringBTreePage<size_t, page_size>::data_size;
+template <typename size_t, size_t page_size>
+const uint16_t StringBTreePage<size_t, page_size>::overflow_flag;
+template <typename size_t, size_t page_size>
+const size_t StringBTreePage<size_t, page_size>::inline_size_max;
+template <typename size_t, size_t page_size>
+const size_t StringBTreePage<size_t, page_size>::overflow_inline_size;
+template <typename size_t, size_t page_size>
+const size_t StringBTreePage<size_t, page_size>::prefix_size_max;
+
+
+// B-tree for `str_t` keys, whose pages hold as many keys as their actual
+// lengths allow, instead of as many as their maximum size does: pages are
+// slotted, keys share a per page prefix, and separators in internal pages are
+// truncated to the shortest string that tells both sides apart. Lookups
+// follow the same semantics as with BTree: duplicate keys are kept, and
+// `lower_bound` finds the first of them. Pages are not merged when keys get
+// erased. Keys may be larger than pages, in which case they span several
+// overflow pages. Not meant for concurrent use.
+
+template <
+    typename size_t, uint32_t key_size=256,
+    size_t reserve_size=1024*1024,
+    size_t page_size=4096, size_t pages_max_count=256
+>
+struct StringBTree : FilePager<StringBTreeHeader<size_t, key_size, page_size>, size_t, page_size, StringBTreePage<size_t, page_size>, pages_max_count> {
+
+    typedef str_t<key_size> key_t;
+    typedef StringBTreePage<size_t, page_size> page_t;
+    typedef typename page_t::entry_t entry_t;
+    typedef StringBTree<size_t, key_size, reserve_size, page_size, pages_max_count> tree_t;
+
+    static const size_t max_depth = 32;
+
+    inline StringBTree(const char* file_path, const int flags=0) :
+        FilePager<
+            StringBTreeHeader<size_t, key_size, page_size>, size_t,
+            page_size, StringBTreePage<size_t, page_size>, pages_max_count
+        >(file_path, reserve_size, flags)
+    {
+        // slot sizes have a bit left for `overflow_flag`, and the first bytes
+        // of long keys fit in the page
+        if (page_t::data_size >= page_t::overflow_flag || page_t::inline_size_max < page_t::overflow_inline_size + sizeof(typename page_t::overflow_t)) {
+            fatal("pages of %lu bytes do not suit string B-trees", (uint64_t)page_size);
+        }
+        if (this->header->must_initialize) {
+            new_page();
+            this->header->must_initialize = false;
+        }
+    }
+
+    static inline const size_t length(const key_t& key) {
+        return key.length();
+    }
+
+    inline page_t& new_page() {
+        size_t page_index = this->header->first_free_page;
+        if (page_index) {
+            // reuse a freed overflow page
+            this->header->first_free_page = this->read_page(page_index).header.next;
+        } else {
+            page_index = this->header->page_count++;
+        }
+        page_t& page = this->get_page(page_index);
+        page.header = {
+            .is_leaf = true,
+            .keys_count = 0,
+            .prefix_size = 0,
+            .heap_begin = page_t::data_size,
+            .garbage_size = 0,
+            .overflow_keys_count = 0,
+            .index = page_index,
+            .prev = 0,
+            .next = 0,
+            .first_child = 0,
+        };
+        return page;
+    }
+
+    // overflow pages hold `data_size` bytes of a key each, and are chained
+    // through their `next` field; they are written from the end of the key,
+    // so that each one knows the next
+    inline const size_t write_overflow(const char* key, const size_t size) {
+        size_t next_index = 0;
+        size_t offset = (size - 1) / page_t::data_size * page_t::data_size;
+        while (true) {
+            page_t& page = new_page();
+            page.header.next = next_index;
+            memcpy(page.data, key + offset, std::min<size_t>(page_t::data_size, size - offset));
+            next_index = page.header.index;
+            this->header->overflow_pages_count++;
+            if (offset == 0) {
+                return next_index;
+            }
+            offset -= page_t::data_size;
+        }
+    }
+    inline void free_overflow(size_t page_index) {
+        while (page_index) {
+            page_t& page = this->get_page(page_index);
+            const size_t next_index = page.header.next;
+            page.header.next = this->header->first_free_page;
+            this->header->first_free_page = page_index;
+            this->header->overflow_pages_count--;
+            page_index = next_index;
+        }
+    }
+    // bytes from `offset` to `offset + size` of the key starting at
+    // `page_index`
+    inline void read_overflow(size_t page_index, size_t offset, char* destination, size_t size) {
+        for (; offset >= page_t::data_size; offset -= page_t::data_size) {
+            page_index = this->read_page(page_index).header.next;
+        }
+        while (size) {
+            const page_t& page = this->read_page(page_index);
+            const size_t chunk_size = std::min<size_t>(size, page_t::data_size - offset);
+            memcpy(destination, page.data + offset, chunk_size);
+            destination += chunk_size;
+            size -= chunk_size;
+            offset = 0;
+            page_index = page.header.next;
+        }
+    }
+    // comparison of `key` with the end of the key of `stored_size` bytes
+    // starting at `page_index`, from `offset` on
+    inline const int compare_overflow(size_t page_index, const size_t stored_size, size_t offset, const char* key, const size_t size) {
+        const size_t remaining_size = stored_size - offset;
+        size_t compared_size = std::min(size, remaining_size);
+        for (; offset >= page_t::data_size; offset -= page_t::data_size) {
+            page_index = this->read_page(page_index).header.next;
+        }
+        while (compared_size) {
+            const page_t& page = this->read_page(page_index);
+            const size_t chunk_size = std::min<size_t>(compared_size, page_t::data_size - offset);
+            const int comparison = memcmp(key, page.data + offset, chunk_size);
+            if (comparison) {
+                return comparison;
+            }
+            key += chunk_size;
+            compared_size -= chunk_size;
+            offset = 0;
+            page_index = page.header.next;
+        }
+        return (size > remaining_size) - (size < remaining_size);
+    }
+    // entries of a page, with keys in overflow pages read from there
+    inline void entries(const size_t page_index, std::vector<entry_t>& result) {
+        const size_t begin = result.size();
+        this->read_page(page_index).entries(result);
+        for (size_t e=begin; e<result.size(); e++) {
+            if (result[e].overflow) {
+                read_overflow(result[e].overflow, 0, &result[e].key[0], result[e].key.size());
+            }
+        }
+    }
+    // position of `key` in `page`; when keys in overflow pages have to be
+    // read, the page stays pinned meanwhile, and references to it valid
+    inline const size_t search(const page_t& page, const char* key, const size_t size, const bool is_upper) {
+        if (!page.header.overflow_keys_count) {
+            return page.search(key, size, is_upper, *this);
+        }
+        this->pin(page.header.index);
+        const size_t result = page.search(key, size, is_upper, *this);
+        this->unpin(page.header.index);
+        return result;
+    }
+
+    // path from the root to the leaf where `key` belongs, as page indices and
+    // child positions in them; returns the depth of the leaf
+    inline const size_t descend(const char* key, const size_t size, const bool is_upper, size_t* path_pages, size_t* path_slots) {
+        size_t page_index = 0;
+        for (size_t depth=0; depth<max_depth; depth++) {
+            const page_t& page = this->read_page(page_index);
+            path_pages[depth] = page_index;
+            if (page.header.is_leaf) {
+                return depth;
+            }
+            path_slots[depth] = search(page, key, size, is_upper);
+            page_index = page.child(path_slots[depth]);
+        }
+        fatal("string B-tree is deeper than %lu in: `%s`", (uint64_t)max_depth, this->_path.c_str());
+        return 0;
+    }
+
+    // insertion: keys go after their duplicates; pages that get full are
+    // rebuilt, with a shorter prefix or split in two
+    inline const bool insert(const key_t& key, const size_t value) {
+        const size_t size = length(key);
+        const size_t overflow = (size > page_t::inline_size_max) ? write_overflow(key.data(), size) : 0;
+        size_t path_pages[max_depth];
+        size_t path_slots[max_depth];
+        const size_t depth = descend(key.data(), size, true, path_pages, path_slots);
+        const size_t index = search(this->read_page(path_pages[depth]), key.data(), size, true);
+        if (this->get_page(path_pages[depth]).insert(index, key.data(), size, value, overflow)) {
+            return true;
+        }
+        std::vector<entry_t> entries;
+        this->entries(path_pages[depth], entries);
+        entries.insert(entries.begin() + index, entry_t(std::string(key.data(), size), value, overflow));
+        store(entries, path_pages, path_slots, depth);
+        return true;
+    }
+    // rewrite the page at `path_pages[depth]` with `entries`; when they do
+    // not fit, the page is split, and a separator is inserted in its parent
+    inline void store(const std::vector<entry_t>& entries, const size_t* path_pages, const size_t* path_slots, const size_t depth) {
+        const size_t page_index = path_pages[depth];
+        if (page_t::fits(entries, 0, entries.size())) {
+            this->get_page(page_index).rebuild(entries, 0, entries.size());
+            return;
+        }
+        const page_t& page = this->read_page(page_index);
+        const bool is_leaf = page.header.is_leaf;
+        const size_t first_child = page.header.first_child;
+        const size_t next_index = page.header.next;
+        // both halves take about as much room
+        const size_t middle = split_point(entries);
+        std::string separator;
+        size_t separator_overflow = 0;
+        size_t right_first_child = 0;
+        size_t right_begin = middle;
+        if (is_leaf) {
+            // with its own overflow pages when needed, as the key it comes
+            // from may get erased
+            separator = truncate(entries[middle - 1].key, entries[middle].key);
+            if (separator.size() > page_t::inline_size_max) {
+                separator_overflow = write_overflow(separator.data(), separator.size());
+            }
+        } else {
+            // the middle separator moves up
+            separator = entries[middle].key;
+            separator_overflow = entries[middle].overflow;
+            right_first_child = entries[middle].value;
+            right_begin = middle + 1;
+        }
+        if (depth == 0) {
+            // the root stays on page 0, its halves move to new pages
+            const size_t left_index = new_page().header.index;
+            const size_t right_index = new_page().header.index;
+            fill(left_index, is_leaf, first_child, entries, 0, middle);
+            fill(right_index, is_leaf, right_first_child, entries, right_begin, entries.size());
+            if (is_leaf) {
+                this->get_page(left_index).header.next = right_index;
+                this->get_page(right_index).header.prev = left_index;
+            }
+            page_t& root = this->get_page(0);
+            root.header.is_leaf = false;
+            root.header.first_child = left_index;
+            root.header.prev = 0;
+            root.header.next = 0;
+            root.rebuild(std::vector<entry_t>(1, entry_t(separator, right_index, separator_overflow)), 0, 1);
+            return;
+        }
+        const size_t right_index = new_page().header.index;
+        fill(right_index, is_leaf, right_first_child, entries, right_begin, entries.size());
+        this->get_page(page_index).rebuild(entries, 0, middle);
+        if (is_leaf) {
+            page_t& right = this->get_page(right_index);
+            right.header.prev = page_index;
+            right.header.next = next_index;
+            this->get_page(page_index).header.next = right_index;
+            if (next_index) {
+                this->get_page(next_index).header.prev = right_index;
+            }
+        }
+        // the separator goes in the parent, right of the split page
+        const size_t slot = path_slots[depth - 1];
+        page_t& parent = this->get_page(path_pages[depth - 1]);
+        if (!parent.insert(slot, separator.data(), separator.size(), right_index, separator_overflow)) {
+            std::vector<entry_t> parent_entries;
+            this->entries(path_pages[depth - 1], parent_entries);
+            parent_entries.insert(parent_entries.begin() + slot, entry_t(separator, right_index, separator_overflow));
+            store(parent_entries, path_pages, path_slots, depth - 1);
+        }
+    }
+    inline void fill(const size_t page_index, const bool is_leaf, const size_t first_child, const std::vector<entry_t>& entries, const size_t begin, const size_t end) {
+        page_t& page = this->get_page(page_index);
+        page.header.is_leaf = is_leaf;
+        page.header.first_child = first_child;
+        page.rebuild(entries, begin, end);
+    }
+    // index of the first entry of the right half, leaving at least one entry
+    // on each side
+    static inline const size_t split_point(const std::vector<entry_t>& entries) {
+        size_t total_size = 0;
+        for (size_t e=0; e<entries.size(); e++) {
+            total_size += page_t::stored_size(entries[e], 0);
+        }
+        size_t size = 0;
+        size_t middle = 0;
+        while (middle < entries.size() - 1 && 2 * size < total_size) {
+            size += page_t::stored_size(entries[middle++], 0);
+        }
+        return std::max<size_t>(1, std::min<size_t>(middle, entries.size() - 2));
+    }
+    // suffix truncation: shortest prefix of `right` that is greater than
+    // `left`, or `right` itself when both are equal
+    static inline const std::string truncate(const std::string& left, const std::string& right) {
+        const size_t size = page_t::common_prefix_size(left, right) + 1;
+        return (size > right.size()) ? right : right.substr(0, size);
+    }
+
+    // removal of the first entry with `key` (and `value`, when matching it),
+    // along with its overflow pages; leaves may become empty, they stay in
+    // the tree
+    inline const bool erase(const key_t& key) {
+        return erase(key, 0, false);
+    }
+    inline const bool erase(const key_t& key, const size_t value, const bool match_value=true) {
+        for (cursor_t it=lower_bound(key); it!=end() && it.key()==key; ++it) {
+            if (!match_value || it.value() == value) {
+                free_overflow(this->get_page(it._page_index).erase(it._index));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // cursors
+    struct cursor_t {
+        tree_t* _tree;
+        size_t _page_index;
+        size_t _index;
+        key_t _key;
+        size_t _value;
+
+        inline cursor_t() : _tree(NULL), _page_index(-1), _index(-1) {}
+        inline cursor_t(tree_t* tree, const size_t page_index, const size_t index) : _tree(tree), _page_index(page_index), _index(index) {
+            settle();
+        }
+        inline const key_t& key() {
+            return _key;
+        }
+        inline const size_t& value() {
+            return _value;
+        }
+        inline const bool operator != (const cursor_t& other) {
+            return _page_index != other._page_index || _index != other._index;
+        }
+        inline void operator ++ () {
+            _index++;
+            settle();
+        }
+        // copy the entry at `_index`, moving on to the next leaves while out
+        // of bounds
+        inline void settle() {
+            while (true) {
+                const page_t& page = _tree->read_page(_page_index);
+                if (_index < page.header.keys_count) {
+                    const size_t size = page.key_size(_index);
+                    _value = page.value(_index);
+                    if (page.is_overflow(_index)) {
+                        _tree->read_overflow(page.overflow(_index).first_page, 0, _key._data, size);
+                    } else {
+                        page.get_key(_index, _key._data);
+                    }
+                    // comparisons stop at the terminator
+                    if (size < key_size) {
+                        _key._data[size] = 0;
+                    }
+                    return;
+                }
+                if (page.header.next == 0) {
+                    _page_index = -1;
+                    _index = -1;
+                    return;
+                }
+                _page_index = page.header.next;
+                _index = 0;
+            }
+        }
+    };
+    inline cursor_t bound(const key_t& key, const bool is_upper) {
+        const size_t size = length(key);
+        size_t path_pages[max_depth];
+        size_t path_slots[max_depth];
+        const size_t leaf_index = path_pages[descend(key.data(), size, is_upper, path_pages, path_slots)];
+        return cursor_t(this, leaf_index, search(this->read_page(leaf_index), key.data(), size, is_upper));
+    }
+    inline cursor_t lower_bound(const key_t& key) {
+        return bound(key, false);
+    }
+    inline cursor_t upper_bound(const key_t& key) {
+        return bound(key, true);
+    }
+    inline cursor_t find(const key_t& key) {
+        cursor_t cursor = lower_bound(key);
+        if (cursor != end() && !(cursor.key() == key)) {
+            return end();
+        }
+        return cursor;
+    }
+    inline std::pair<cursor_t, cursor_t> equal_range(const key_t& key) {
+        return std::pair<cursor_t, cursor_t>(lower_bound(key), upper_bound(key));
+    }
+    inline cursor_t begin() {
+        size_t page_index = 0;
+        while (!this->read_page(page_index).header.is_leaf) {
+            page_index = this->read_page(page_index).header.first_child;
+        }
+        return cursor_t(this, page_index, 0);
+    }
+    static inline cursor_t end() {
+        return cursor_t();
+    }
+
+    // range scan over [lo, hi); stops early when `callback(key, value)`
+    // returns false, and returns the number of visited keys
+    template <typename callback_t>
+    inline const size_t scan(const key_t& lo, const key_t& hi, callback_t callback) {
+        size_t count = 0;
+        for (cursor_t it=lower_bound(lo); it!=end() && it.key()<hi; ++it) {
+            count++;
+            if (!callback(it.key(), it.value())) {
+                break;
+            }
+        }
+        return count;
+    }
+
+    // consistency: keys of each page are sorted and within the separators
+    // of their ancestors, leaves are linked in order
+    inline bool check() {
+        if (!check(0, NULL, NULL)) {
+            return false;
+        }
+        size_t count = 0;
+        key_t previous;
+        for (cursor_t it=begin(); it!=end(); ++it) {
+            if (count++ && it.key() < previous) {
+                error("leaves are not linked in order in: `%s`", this->_path.c_str());
+                return false;
+            }
+            previous = it.key();
+        }
+        return true;
+    }
+    inline bool check(const size_t page_index, const std::string* lo, const std::string* hi) {
+        std::vector<size_t> children;
+        {
+            const page_t& page = this->read_page(page_index);
+            for (size_t c=0; !page.header.is_leaf && c<=page.header.keys_count; c++) {
+                children.push_back(page.child(c));
+            }
+        }
+        std::vector<entry_t> entries;
+        this->entries(page_index, entries);
+        for (size_t e=0; e<entries.size(); e++) {
+            if ((e && entries[e].key < entries[e - 1].key) || (lo && entries[e].key < *lo) || (hi && *hi < entries[e].key)) {
+                error("key `%s` out of order in page %lu of: `%s`", entries[e].key.c_str(), (uint64_t)page_index, this->_path.c_str());
+                return false;
+            }
+        }
+        for (size_t c=0; c<children.size(); c++) {
+            if (!check(children[c], c ? &entries[c - 1].key : lo, (c < entries.size()) ? &entries[c].key : hi)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+template <typename size_t, uint32_t key_size, size_t reserve_size, size_t page_size, size_t pages_max_count>
+const size_t StringBTree<size_t, key_size, reserve_size, page_size, pages_max_count>::max_depth;
+
+
+#endif // __INCLUDED__StringBTree_hpp__
@@ -0,0 +1,74 @@
+#ifndef __INCLUDED__utils__arena_hpp__
+#define __INCLUDED__utils__arena_hpp__
+
+
+#include "util/logging.hpp"
+
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+// Page arena: pages are carved out of large anonymous mappings (slabs), so
+// they are aligned on the system page size, as O_DIRECT and vector
+// instructions like; released pages are chained in a free list, through
+// their first bytes, and handed out again before carving new ones. Slabs
+// are only unmapped with the arena.
+
+template <typename size_t, size_t page_size>
+struct PageArena {
+
+    static const size_t slab_size = (page_size > 2 * 1024 * 1024) ? page_size : (2 * 1024 * 1024 / page_size) * page_size;
+
+    std::vector<char*> _slabs;
+    // next page to carve in the last slab
+    size_t _slab_offset;
+    void* _free_list;
+    size_t _allocated_count;
+
+    inline PageArena() : _slab_offset(slab_size), _free_list(NULL), _allocated_count(0) {}
+    inline ~PageArena() {
+        for (size_t s=0; s<_slabs.size(); s++) {
+            munmap(_slabs[s], slab_size);
+        }
+    }
+
+    inline void* allocate() {
+        _allocated_count++;
+        if (_free_list) {
+            void* page = _free_list;
+            _free_list = * (void**) page;
+            return page;
+        }
+        if (_slab_offset == slab_size) {
+            char* slab = (char*) mmap(NULL, slab_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (slab == MAP_FAILED) {
+                fatal("could not allocate %lu bytes (%s)", (uint64_t)slab_size, strerror(errno));
+            }
+            _slabs.push_back(slab);
+            _slab_offset = 0;
+        }
+        void* page = _slabs.back() + _slab_offset;
+        _slab_offset += page_size;
+        return page;
+    }
+    inline void release(void* page) {
+        _allocated_count--;
+        * (void**) page = _free_list;
+        _free_list = page;
+    }
+
+    // number of pages handed out and not released
+    inline const size_t allocated_count() const {
+        return _allocated_count;
+    }
+
+};
+
+template <typename size_t, size_t page_size>
+const size_t PageArena<size_t, page_size>::slab_size;
+
+
+#endif // __INCLUDED__utils__arena_hpp__
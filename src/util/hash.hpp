@@ -0,0 +1,94 @@
+#ifndef __INCLUDED__utils__hash_hpp__
+#define __INCLUDED__utils__hash_hpp__
+
+
+#include <stdint.h>
+#include <string.h>
+
+
+// Hashing of byte strings, eight bytes at a time, after wyhash: words get
+// mixed by 64x64 to 128 bits multiplications, whose both halves are folded
+// together. Strings up to 16 bytes long take a single multiplication.
+
+namespace hash_internals {
+
+    static const uint64_t secret[4] = {
+        0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+        0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+    };
+
+    static inline void multiply(uint64_t& a, uint64_t& b) {
+        const __uint128_t product = (__uint128_t) a * b;
+        a = (uint64_t) product;
+        b = (uint64_t) (product >> 64);
+    }
+    static inline const uint64_t mix(uint64_t a, uint64_t b) {
+        multiply(a, b);
+        return a ^ b;
+    }
+    static inline const uint64_t read64(const uint8_t* data) {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        return word;
+    }
+    static inline const uint64_t read32(const uint8_t* data) {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        return word;
+    }
+    // 1 to 3 bytes
+    static inline const uint64_t read_small(const uint8_t* data, const size_t length) {
+        return ((uint64_t) data[0] << 16) | ((uint64_t) data[length >> 1] << 8) | data[length - 1];
+    }
+
+}
+
+static inline const uint64_t hash_bytes(const void* bytes, const size_t length, uint64_t seed=0) {
+    using namespace hash_internals;
+    const uint8_t* data = (const uint8_t*) bytes;
+    seed ^= mix(seed ^ secret[0], secret[1]);
+    uint64_t a;
+    uint64_t b;
+    if (length <= 16) {
+        if (length >= 4) {
+            const size_t middle = (length >> 3) << 2;
+            a = (read32(data) << 32) | read32(data + middle);
+            b = (read32(data + length - 4) << 32) | read32(data + length - 4 - middle);
+        } else if (length > 0) {
+            a = read_small(data, length);
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t remaining = length;
+        // three independent lanes for long strings
+        if (remaining > 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed = mix(read64(data) ^ secret[1], read64(data + 8) ^ seed);
+                seed1 = mix(read64(data + 16) ^ secret[2], read64(data + 24) ^ seed1);
+                seed2 = mix(read64(data + 32) ^ secret[3], read64(data + 40) ^ seed2);
+                data += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = mix(read64(data) ^ secret[1], read64(data + 8) ^ seed);
+            data += 16;
+            remaining -= 16;
+        }
+        // the last 16 bytes, overlapping previous ones if needed
+        a = read64(data + remaining - 16);
+        b = read64(data + remaining - 8);
+    }
+    a ^= secret[1];
+    b ^= seed;
+    multiply(a, b);
+    return mix(a ^ secret[0] ^ length, b ^ secret[1]);
+}
+
+
+#endif // __INCLUDED__utils__hash_hpp__
@@ -0,0 +1,271 @@
+#ifndef __INCLUDED__utils__latches_hpp__
+#define __INCLUDED__utils__latches_hpp__
+
+
+#include "util/logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+
+
+// Optimistic latch: a version word whose bit 1 means "locked". Readers never
+// write to it, they only check after reading that the version did not change;
+// writers lock it, which bumps the version once they unlock it. Pages are
+// freed while locked, so readers of a freed page see its version change.
+
+struct OptimisticLatch {
+
+    std::atomic<uint64_t> _version;
+
+    static inline const bool is_locked(const uint64_t version) {
+        return version & 2;
+    }
+
+    // readers
+    inline const uint64_t read_lock() const {
+        uint64_t version = _version.load(std::memory_order_acquire);
+        while (is_locked(version)) {
+            sched_yield();
+            version = _version.load(std::memory_order_acquire);
+        }
+        return version;
+    }
+    inline const bool check(const uint64_t version) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return _version.load(std::memory_order_relaxed) == version;
+    }
+
+    // writers
+    inline const bool upgrade(uint64_t version) {
+        return _version.compare_exchange_strong(version, version + 2, std::memory_order_acquire);
+    }
+    inline void write_lock() {
+        while (!upgrade(read_lock()));
+    }
+    inline void write_unlock() {
+        _version.fetch_add(2, std::memory_order_release);
+    }
+
+};
+
+
+// Latches for pages, looked up by page index: they live in memory only, in
+// chunks that get allocated on demand and are never moved nor freed before
+// the table itself, so that a crashed writer never leaves a page locked
+
+template <typename size_t>
+struct LatchTable {
+
+    static const size_t chunk_size = 1 << 14;
+    static const size_t directory_size = 1 << 14;
+
+    std::atomic<OptimisticLatch*>* _directory;
+    pthread_mutex_t _mutex;
+
+    inline LatchTable() {
+        _directory = (std::atomic<OptimisticLatch*>*) calloc(directory_size, sizeof(std::atomic<OptimisticLatch*>));
+        if (_directory == NULL) {
+            fatal("could not allocate latches directory");
+        }
+        pthread_mutex_init(&_mutex, NULL);
+    }
+    inline ~LatchTable() {
+        for (size_t c=0; c<directory_size; c++) {
+            free(_directory[c].load());
+        }
+        free(_directory);
+        pthread_mutex_destroy(&_mutex);
+    }
+
+    inline OptimisticLatch& operator [] (const size_t page_index) {
+        const size_t chunk_index = (uint64_t) page_index / chunk_size;
+        if (chunk_index >= directory_size) {
+            fatal("no latch for page %lu", (uint64_t)page_index);
+        }
+        OptimisticLatch* chunk = _directory[chunk_index].load(std::memory_order_acquire);
+        if (chunk == NULL) {
+            pthread_mutex_lock(&_mutex);
+            chunk = _directory[chunk_index].load(std::memory_order_acquire);
+            if (chunk == NULL) {
+                chunk = (OptimisticLatch*) calloc(chunk_size, sizeof(OptimisticLatch));
+                if (chunk == NULL) {
+                    fatal("could not allocate latches for page %lu", (uint64_t)page_index);
+                }
+                _directory[chunk_index].store(chunk, std::memory_order_release);
+            }
+            pthread_mutex_unlock(&_mutex);
+        }
+        return chunk[page_index % chunk_size];
+    }
+
+};
+
+
+// Publication watermark, for slots that get reserved in order but written
+// concurrently: each written slot is marked in a bitmap, and the watermark
+// moves over the marked slots, so that all slots below it are complete. Any
+// thread can move it further, nobody waits for another one. The watermark
+// itself is a plain integer, so that it can live in a mapped header.
+
+template <typename size_t>
+struct PublishWatermark {
+
+    static const uint64_t chunk_size = 1 << 20;
+    static const size_t directory_size = 1 << 14;
+
+    size_t* _watermark;
+    std::atomic<std::atomic<uint64_t>*>* _directory;
+    pthread_mutex_t _mutex;
+
+    inline PublishWatermark() : _watermark(NULL) {
+        _directory = (std::atomic<std::atomic<uint64_t>*>*) calloc(directory_size, sizeof(std::atomic<std::atomic<uint64_t>*>));
+        if (_directory == NULL) {
+            fatal("could not allocate watermark directory");
+        }
+        pthread_mutex_init(&_mutex, NULL);
+    }
+    inline ~PublishWatermark() {
+        for (size_t c=0; c<directory_size; c++) {
+            free(_directory[c].load());
+        }
+        free(_directory);
+        pthread_mutex_destroy(&_mutex);
+    }
+    inline void set(size_t* watermark) {
+        _watermark = watermark;
+    }
+
+    // number of complete slots
+    inline const size_t get() const {
+        return __atomic_load_n(_watermark, __ATOMIC_ACQUIRE);
+    }
+    inline void mark(const size_t slot) {
+        word(slot).fetch_or(1ul << ((uint64_t) slot % 64));
+        advance();
+    }
+    // `count` consecutive slots, a word at a time
+    inline void mark(size_t slot, size_t count) {
+        while (count) {
+            const uint64_t offset = (uint64_t) slot % 64;
+            const size_t bits_count = std::min<size_t>(count, 64 - offset);
+            const uint64_t bits = (bits_count == 64) ? ~0ul : ((1ul << bits_count) - 1) << offset;
+            word(slot).fetch_or(bits);
+            slot += bits_count;
+            count -= bits_count;
+        }
+        advance();
+    }
+    inline void advance() {
+        size_t watermark = __atomic_load_n(_watermark, __ATOMIC_SEQ_CST);
+        while (true) {
+            // run of marked slots starting at the watermark
+            const uint64_t offset = (uint64_t) watermark % 64;
+            const uint64_t bits = ~(word(watermark).load() >> offset);
+            const size_t run = bits ? __builtin_ctzl(bits) : 64 - offset;
+            if (run == 0) {
+                return;
+            }
+            if (__atomic_compare_exchange_n(_watermark, &watermark, watermark + run, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                watermark += run;
+            }
+        }
+    }
+
+    // bitmap words, in chunks allocated on demand
+    inline std::atomic<uint64_t>& word(const size_t slot) {
+        const uint64_t chunk_index = (uint64_t) slot / chunk_size;
+        if (chunk_index >= directory_size) {
+            fatal("no watermark bit for slot %lu", (uint64_t)slot);
+        }
+        std::atomic<uint64_t>* chunk = _directory[chunk_index].load(std::memory_order_acquire);
+        if (chunk == NULL) {
+            pthread_mutex_lock(&_mutex);
+            chunk = _directory[chunk_index].load(std::memory_order_acquire);
+            if (chunk == NULL) {
+                chunk = (std::atomic<uint64_t>*) calloc(chunk_size / 64, sizeof(std::atomic<uint64_t>));
+                if (chunk == NULL) {
+                    fatal("could not allocate watermark bits for slot %lu", (uint64_t)slot);
+                }
+                _directory[chunk_index].store(chunk, std::memory_order_release);
+            }
+            pthread_mutex_unlock(&_mutex);
+        }
+        return chunk[((uint64_t) slot % chunk_size) / 64];
+    }
+
+};
+
+
+// Sync statistics: syncs get counted and timed, from any thread.
+
+struct SyncStats {
+
+    std::atomic<uint64_t> _syncs_count;
+    std::atomic<uint64_t> _sync_nanoseconds;
+    std::atomic<uint64_t> _sync_max_nanoseconds;
+
+    inline SyncStats() : _syncs_count(0), _sync_nanoseconds(0), _sync_max_nanoseconds(0) {}
+
+    template <typename sync_t>
+    inline void time(sync_t sync) {
+        timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        sync();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        const uint64_t nanoseconds = (t1.tv_sec - t0.tv_sec) * 1000000000ul + t1.tv_nsec - t0.tv_nsec;
+        _syncs_count++;
+        _sync_nanoseconds += nanoseconds;
+        uint64_t max_nanoseconds = _sync_max_nanoseconds.load();
+        while (nanoseconds > max_nanoseconds && !_sync_max_nanoseconds.compare_exchange_weak(max_nanoseconds, nanoseconds));
+    }
+
+};
+
+
+// Group synchronization: threads asking for everything up to some ticket to
+// be durable share syncs. While one of them syncs, the others wait; the next
+// one then covers everything that was prepared meanwhile. The caller holds
+// `mutex`, under which `prepare()` returns the ticket the upcoming sync will
+// cover; `sync()` itself runs without it.
+
+struct SyncGroup {
+
+    pthread_cond_t _synced;
+    bool _is_syncing;
+    uint64_t _durable;
+    SyncStats _stats;
+
+    inline SyncGroup(const uint64_t durable=0) : _is_syncing(false), _durable(durable) {
+        pthread_cond_init(&_synced, NULL);
+    }
+    inline ~SyncGroup() {
+        pthread_cond_destroy(&_synced);
+    }
+
+    template <typename prepare_t, typename sync_t>
+    inline void sync(pthread_mutex_t* mutex, const uint64_t ticket, prepare_t prepare, sync_t sync) {
+        while (_durable < ticket) {
+            if (_is_syncing) {
+                pthread_cond_wait(&_synced, mutex);
+                continue;
+            }
+            _is_syncing = true;
+            const uint64_t target = prepare();
+            pthread_mutex_unlock(mutex);
+            _stats.time(sync);
+            pthread_mutex_lock(mutex);
+            _durable = target;
+            _is_syncing = false;
+            pthread_cond_broadcast(&_synced);
+        }
+    }
+
+};
+
+
+#endif // __INCLUDED__utils__latches_hpp__
@@ -0,0 +1,72 @@
+#ifndef __INCLUDED__utils__pagetable_hpp__
+#define __INCLUDED__utils__pagetable_hpp__
+
+
+#include "util/logging.hpp"
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+
+// Page table for resident pages: page indices are dense, so frame indices
+// are looked up in a two-level directory rather than hashed; chunks of the
+// directory get allocated when a page they cover is first made resident.
+// Not thread-safe, as the buffer pool itself.
+
+template <typename size_t>
+struct PageTable {
+
+    static const size_t none = (size_t) -1;
+    static const size_t chunk_bits = 12;
+    static const size_t chunk_size = 1 << chunk_bits;
+
+    std::vector<size_t*> _directory;
+
+    inline ~PageTable() {
+        for (size_t c=0; c<_directory.size(); c++) {
+            free(_directory[c]);
+        }
+    }
+
+    // frame holding the page, or `none`
+    inline const size_t find(const size_t page_index) const {
+        const size_t chunk_index = page_index >> chunk_bits;
+        if (chunk_index >= _directory.size() || _directory[chunk_index] == NULL) {
+            return none;
+        }
+        return _directory[chunk_index][page_index & (chunk_size - 1)];
+    }
+    inline void set(const size_t page_index, const size_t frame_index) {
+        const size_t chunk_index = page_index >> chunk_bits;
+        if (chunk_index >= _directory.size()) {
+            _directory.resize(chunk_index + 1, NULL);
+        }
+        if (_directory[chunk_index] == NULL) {
+            _directory[chunk_index] = (size_t*) malloc(chunk_size * sizeof(size_t));
+            if (_directory[chunk_index] == NULL) {
+                fatal("could not allocate page table for page %lu", (uint64_t)page_index);
+            }
+            memset(_directory[chunk_index], 0xFF, chunk_size * sizeof(size_t));
+        }
+        _directory[chunk_index][page_index & (chunk_size - 1)] = frame_index;
+    }
+    inline void erase(const size_t page_index) {
+        const size_t chunk_index = page_index >> chunk_bits;
+        if (chunk_index < _directory.size() && _directory[chunk_index]) {
+            _directory[chunk_index][page_index & (chunk_size - 1)] = none;
+        }
+    }
+
+};
+
+template <typename size_t>
+const size_t PageTable<size_t>::none;
+template <typename size_t>
+const size_t PageTable<size_t>::chunk_bits;
+template <typename size_t>
+const size_t PageTable<size_t>::chunk_size;
+
+
+#endif // __INCLUDED__utils__pagetable_hpp__
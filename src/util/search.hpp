@@ -0,0 +1,165 @@
+#ifndef __INCLUDED__utils__search_hpp__
+#define __INCLUDED__utils__search_hpp__
+
+
+#include <stdint.h>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+
+// SIMD lanes for fixed-width integral keys: the vectorized part is only
+// available when the target supports comparison on that width
+
+template <std::size_t key_size>
+struct SearchLanes {
+    static const bool is_available = false;
+};
+
+#if defined(__SSE2__)
+template <>
+struct SearchLanes<4> {
+    static const bool is_available = true;
+    template <typename key_t>
+    static inline const uint32_t bias(const key_t key) {
+        // unsigned keys are shifted so that signed comparisons apply
+        return std::is_signed<key_t>::value ? (uint32_t) key : (uint32_t) key ^ 0x80000000u;
+    }
+    // number of keys strictly greater than `key` (or strictly lower, when
+    // `is_less` is set)
+    template <bool is_less, typename key_t>
+    static inline const std::size_t count(const key_t* keys, const std::size_t n, const key_t& key) {
+        std::size_t count = 0;
+        std::size_t i = 0;
+        const uint32_t flip = std::is_signed<key_t>::value ? 0 : 0x80000000u;
+#if defined(__AVX2__)
+        const __m256i pivot256 = _mm256_set1_epi32(bias(key));
+        const __m256i flip256 = _mm256_set1_epi32(flip);
+        for (; i + 8 <= n; i += 8) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (keys + i)), flip256);
+            __m256i mask = is_less ? _mm256_cmpgt_epi32(pivot256, v) : _mm256_cmpgt_epi32(v, pivot256);
+            count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(mask)));
+        }
+#endif
+        const __m128i pivot128 = _mm_set1_epi32(bias(key));
+        const __m128i flip128 = _mm_set1_epi32(flip);
+        for (; i + 4 <= n; i += 4) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (keys + i)), flip128);
+            __m128i mask = is_less ? _mm_cmpgt_epi32(pivot128, v) : _mm_cmpgt_epi32(v, pivot128);
+            count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+        }
+        for (; i < n; i++) {
+            count += is_less ? (keys[i] < key) : (key < keys[i]);
+        }
+        return count;
+    }
+};
+#endif
+
+#if defined(__SSE4_2__)
+template <>
+struct SearchLanes<8> {
+    static const bool is_available = true;
+    template <typename key_t>
+    static inline const uint64_t bias(const key_t key) {
+        return std::is_signed<key_t>::value ? (uint64_t) key : (uint64_t) key ^ 0x8000000000000000ul;
+    }
+    template <bool is_less, typename key_t>
+    static inline const std::size_t count(const key_t* keys, const std::size_t n, const key_t& key) {
+        std::size_t count = 0;
+        std::size_t i = 0;
+        const uint64_t flip = std::is_signed<key_t>::value ? 0 : 0x8000000000000000ul;
+#if defined(__AVX2__)
+        const __m256i pivot256 = _mm256_set1_epi64x(bias(key));
+        const __m256i flip256 = _mm256_set1_epi64x(flip);
+        for (; i + 4 <= n; i += 4) {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (keys + i)), flip256);
+            __m256i mask = is_less ? _mm256_cmpgt_epi64(pivot256, v) : _mm256_cmpgt_epi64(v, pivot256);
+            count += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+        }
+#endif
+        const __m128i pivot128 = _mm_set1_epi64x(bias(key));
+        const __m128i flip128 = _mm_set1_epi64x(flip);
+        for (; i + 2 <= n; i += 2) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (keys + i)), flip128);
+            __m128i mask = is_less ? _mm_cmpgt_epi64(pivot128, v) : _mm_cmpgt_epi64(v, pivot128);
+            count += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+        }
+        for (; i < n; i++) {
+            count += is_less ? (keys[i] < key) : (key < keys[i]);
+        }
+        return count;
+    }
+};
+#endif
+
+
+// Search in sorted arrays: `lower_bound` returns the index of the first key
+// not lower than `key`, `upper_bound` the index of the first key strictly
+// greater than `key`; both return `count` when there is no such key
+
+template <
+    typename size_t, typename key_t,
+    bool is_vectorized = std::is_integral<key_t>::value && SearchLanes<sizeof(key_t)>::is_available
+>
+struct SortedSearch {
+    // branchless binary search, for keys of any size
+    static inline const size_t lower_bound(const key_t* keys, const size_t count, const key_t& key) {
+        if (count == 0) {
+            return 0;
+        }
+        const key_t* base = keys;
+        size_t n = count;
+        while (n > 1) {
+            const size_t half = n / 2;
+            base = (base[half - 1] < key) ? base + half : base;
+            n -= half;
+        }
+        return (base - keys) + (*base < key);
+    }
+    static inline const size_t upper_bound(const key_t* keys, const size_t count, const key_t& key) {
+        if (count == 0) {
+            return 0;
+        }
+        const key_t* base = keys;
+        size_t n = count;
+        while (n > 1) {
+            const size_t half = n / 2;
+            base = (key < base[half]) ? base : base + half;
+            n -= half;
+        }
+        return (base - keys) + !(key < *base);
+    }
+};
+
+template <typename size_t, typename key_t>
+struct SortedSearch<size_t, key_t, true> {
+    // narrow down with a branchless binary search, then count the remaining
+    // window with vector comparisons
+    static const size_t window = 64 / sizeof(key_t);
+    static inline const size_t lower_bound(const key_t* keys, const size_t count, const key_t& key) {
+        const key_t* base = keys;
+        size_t n = count;
+        while (n > window) {
+            const size_t half = n / 2;
+            base = (base[half - 1] < key) ? base + half : base;
+            n -= half;
+        }
+        return (base - keys) + SearchLanes<sizeof(key_t)>::template count<true>(base, n, key);
+    }
+    static inline const size_t upper_bound(const key_t* keys, const size_t count, const key_t& key) {
+        const key_t* base = keys;
+        size_t n = count;
+        while (n > window) {
+            const size_t half = n / 2;
+            base = (key < base[half]) ? base : base + half;
+            n -= half;
+        }
+        return (base - keys) + n - SearchLanes<sizeof(key_t)>::template count<false>(base, n, key);
+    }
+};
+
+
+#endif // __INCLUDED__utils__search_hpp__
@@ -0,0 +1,134 @@
+#ifndef __INCLUDED__utils__sort_hpp__
+#define __INCLUDED__utils__sort_hpp__
+
+
+#include "util/logging.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+
+// External sort for fixed-size records: records are buffered in memory by
+// runs of `run_size`, every full run is sorted and spilled to a temporary
+// file, and the runs are finally merged while iterating
+
+template <typename record_t, typename compare_t=std::less<record_t>>
+struct ExternalSort {
+
+    std::string _path;
+    size_t _run_size;
+    std::vector<record_t> _buffer;
+    std::vector<FILE*> _runs;
+    compare_t _compare;
+
+    inline ExternalSort(const std::string& path, const size_t run_size) : _path(path), _run_size(run_size) {
+        _buffer.reserve(run_size);
+    }
+    inline ~ExternalSort() {
+        for (size_t r=0; r<_runs.size(); r++) {
+            fclose(_runs[r]);
+            unlink(run_path(r).c_str());
+        }
+    }
+
+    inline void push(const record_t& record) {
+        if (_buffer.size() >= _run_size) {
+            spill();
+        }
+        _buffer.push_back(record);
+    }
+
+    // merged, sorted output
+    struct head_t {
+        record_t record;
+        size_t run_index;
+    };
+    struct head_compare_t {
+        compare_t _compare;
+        inline const bool operator () (const head_t& a, const head_t& b) {
+            return _compare(b.record, a.record);
+        }
+    };
+    struct iterator {
+        ExternalSort<record_t, compare_t>* _sort;
+        size_t _index;
+        std::priority_queue<head_t, std::vector<head_t>, head_compare_t> _heads;
+        inline iterator() : _sort(NULL) {}
+        inline iterator(ExternalSort<record_t, compare_t>* sort) : _sort(sort), _index(0) {
+            for (size_t r=0; r<_sort->_runs.size(); r++) {
+                rewind(_sort->_runs[r]);
+                read(r);
+            }
+        }
+        inline void read(const size_t run_index) {
+            head_t head;
+            if (fread(&head.record, sizeof(record_t), 1, _sort->_runs[run_index]) == 1) {
+                head.run_index = run_index;
+                _heads.push(head);
+            }
+        }
+        inline const bool is_end() const {
+            return _sort == NULL || (_sort->_runs.size() ? _heads.empty() : _index >= _sort->_buffer.size());
+        }
+        inline const bool operator != (const iterator& other) const {
+            return is_end() != other.is_end();
+        }
+        inline const record_t& operator * () const {
+            return _sort->_runs.size() ? _heads.top().record : _sort->_buffer[_index];
+        }
+        inline const record_t* operator -> () const {
+            return & **this;
+        }
+        inline void operator ++ () {
+            if (_sort->_runs.size()) {
+                const size_t run_index = _heads.top().run_index;
+                _heads.pop();
+                read(run_index);
+            } else {
+                _index++;
+            }
+        }
+    };
+    inline iterator begin() {
+        if (_runs.size()) {
+            if (_buffer.size()) {
+                spill();
+            }
+        } else {
+            std::sort(_buffer.begin(), _buffer.end(), _compare);
+        }
+        return iterator(this);
+    }
+    inline iterator end() {
+        return iterator();
+    }
+
+    // runs
+    inline const std::string run_path(const size_t run_index) const {
+        return _path + "." + std::to_string(run_index);
+    }
+    inline void spill() {
+        std::sort(_buffer.begin(), _buffer.end(), _compare);
+        const std::string path = run_path(_runs.size());
+        FILE* run = fopen(path.c_str(), "w+b");
+        if (run == NULL) {
+            fatal("could not open: `%s` (%s)", path.c_str(), strerror(errno));
+        }
+        if (fwrite(_buffer.data(), sizeof(record_t), _buffer.size(), run) != _buffer.size()) {
+            fatal("could not write to: `%s` (%s)", path.c_str(), strerror(errno));
+        }
+        _runs.push_back(run);
+        _buffer.clear();
+    }
+
+};
+
+
+#endif // __INCLUDED__utils__sort_hpp__
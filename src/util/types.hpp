@@ -2,10 +2,20 @@
 #define __INCLUDED__utils__types_hpp__
 
 
+#include "util/hash.hpp"
+
+#include <string>
 #include <unordered_map>
 
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-// fixed-sized character strings
+
+// fixed-sized character strings: only the bytes up to the first null one
+// matter, the following ones are not compared
 
 template<uint32_t size=256>
 struct str_t {
@@ -16,12 +26,65 @@ struct str_t {
     inline str_t(const char* source) {
         strncpy(_data, source, size);
     }
+    // the whole buffer at once, which takes a few vector moves, rather than
+    // up to the end of the string
     inline str_t(const str_t<size>& source) {
-        strncpy(_data, source._data, size);
+        memcpy(_data, source._data, size);
     }
 
+    inline const uint32_t length() const {
+        return strnlen(_data, size);
+    }
+
+    // as strncmp, a vector at a time: the first differing or null byte is
+    // looked for in each block; the last block may overlap the previous one,
+    // whose bytes are equal and not null
     inline const int comp(const str_t<size>& other) const {
-        return memcmp(_data, other._data, size);
+        const uint8_t* a = (const uint8_t*) _data;
+        const uint8_t* b = (const uint8_t*) other._data;
+#if defined(__AVX2__)
+        if (size >= 32) {
+            for (uint32_t i=0; ; ) {
+                const __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+                const __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+                // null where bytes differ or are null
+                const __m256i v = _mm256_min_epu8(va, _mm256_cmpeq_epi8(va, vb));
+                const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+                if (mask) {
+                    const uint32_t j = i + __builtin_ctz(mask);
+                    return (int) a[j] - (int) b[j];
+                }
+                if (i + 32 == size) {
+                    return 0;
+                }
+                i = (i + 64 <= size) ? i + 32 : size - 32;
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        if (size >= 16) {
+            for (uint32_t i=0; ; ) {
+                const __m128i va = _mm_loadu_si128((const __m128i*) (a + i));
+                const __m128i vb = _mm_loadu_si128((const __m128i*) (b + i));
+                const __m128i v = _mm_min_epu8(va, _mm_cmpeq_epi8(va, vb));
+                const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+                if (mask) {
+                    const uint32_t j = i + __builtin_ctz(mask);
+                    return (int) a[j] - (int) b[j];
+                }
+                if (i + 16 == size) {
+                    return 0;
+                }
+                i = (i + 32 <= size) ? i + 16 : size - 16;
+            }
+        }
+#endif
+        for (uint32_t i=0; i<size; i++) {
+            if (a[i] != b[i] || a[i] == 0) {
+                return (int) a[i] - (int) b[i];
+            }
+        }
+        return 0;
     }
 
     inline bool operator != (const char* other) const {
@@ -67,16 +130,11 @@ struct str_t {
 };
 
 namespace std {
+    // over the actual length of the string, never past `size`
     template<uint32_t size>
     struct hash<str_t<size>> {
         std::size_t operator()(const str_t<size>& str) const {
-            const char* data = str.data();
-            std::size_t hash = 31;
-            while (*data) {
-                hash = (hash * 54059) ^ (data[0] * 76963);
-                data++;
-            }
-            return hash;
+            return hash_bytes(str.data(), str.length());
         }
     };
 }
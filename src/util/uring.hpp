@@ -0,0 +1,192 @@
+#ifndef __INCLUDED__utils__uring_hpp__
+#define __INCLUDED__utils__uring_hpp__
+
+
+#include "util/logging.hpp"
+
+#include <algorithm>
+
+#include <linux/io_uring.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+// Asynchronous I/O rings (io_uring), through raw system calls: requests are
+// queued in a submission ring shared with the kernel, submitted at once, and
+// their results come back in a completion ring, so that one thread can keep
+// many reads or writes in flight. When the kernel does not provide io_uring,
+// `is_available()` is false and callers should use plain system calls.
+
+struct IoRing {
+
+    int _handle;
+    unsigned _entries;
+    // submission ring
+    char* _sq_ring;
+    size_t _sq_ring_size;
+    unsigned* _sq_head;
+    unsigned* _sq_tail;
+    unsigned* _sq_mask;
+    unsigned* _sq_array;
+    io_uring_sqe* _sqes;
+    size_t _sqes_size;
+    // completion ring (shares the submission ring mapping when possible)
+    char* _cq_ring;
+    size_t _cq_ring_size;
+    unsigned* _cq_head;
+    unsigned* _cq_tail;
+    unsigned* _cq_mask;
+    io_uring_cqe* _cqes;
+    // requests queued but not submitted yet, submitted but not completed yet
+    unsigned _queued;
+    unsigned _in_flight;
+
+    inline IoRing(const unsigned entries) : _handle(-1), _entries(0), _sq_ring(NULL), _sqes(NULL), _cq_ring(NULL), _queued(0), _in_flight(0) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _handle = syscall(__NR_io_uring_setup, entries, &params);
+        if (_handle == -1) {
+            return;
+        }
+        _entries = params.sq_entries;
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+        _sq_ring = (char*) mmap(NULL, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _handle, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED) {
+            fatal("could not map submission ring (%s)", strerror(errno));
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            _cq_ring = _sq_ring;
+        } else {
+            _cq_ring = (char*) mmap(NULL, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _handle, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED) {
+                fatal("could not map completion ring (%s)", strerror(errno));
+            }
+        }
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = (io_uring_sqe*) mmap(NULL, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _handle, IORING_OFF_SQES);
+        if (_sqes == MAP_FAILED) {
+            fatal("could not map submission entries (%s)", strerror(errno));
+        }
+        _sq_head = (unsigned*) (_sq_ring + params.sq_off.head);
+        _sq_tail = (unsigned*) (_sq_ring + params.sq_off.tail);
+        _sq_mask = (unsigned*) (_sq_ring + params.sq_off.ring_mask);
+        _sq_array = (unsigned*) (_sq_ring + params.sq_off.array);
+        _cq_head = (unsigned*) (_cq_ring + params.cq_off.head);
+        _cq_tail = (unsigned*) (_cq_ring + params.cq_off.tail);
+        _cq_mask = (unsigned*) (_cq_ring + params.cq_off.ring_mask);
+        _cqes = (io_uring_cqe*) (_cq_ring + params.cq_off.cqes);
+    }
+    inline ~IoRing() {
+        if (_handle == -1) {
+            return;
+        }
+        munmap(_sqes, _sqes_size);
+        if (_cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        munmap(_sq_ring, _sq_ring_size);
+        close(_handle);
+    }
+
+    inline const bool is_available() const {
+        return _handle != -1;
+    }
+    // number of requests that can be pending at once
+    inline const unsigned capacity() const {
+        return _entries;
+    }
+
+    // queueing; `user_data` is passed back with the result
+    inline void read(const int handle, void* data, const unsigned size, const uint64_t offset, const uint64_t user_data) {
+        io_uring_sqe& sqe = queue(IORING_OP_READ, handle, offset, user_data);
+        sqe.addr = (uint64_t) data;
+        sqe.len = size;
+    }
+    inline void write(const int handle, const void* data, const unsigned size, const uint64_t offset, const uint64_t user_data) {
+        io_uring_sqe& sqe = queue(IORING_OP_WRITE, handle, offset, user_data);
+        sqe.addr = (uint64_t) data;
+        sqe.len = size;
+    }
+    // `iov` has to stay valid until the request completes
+    inline void writev(const int handle, const iovec* iov, const unsigned count, const uint64_t offset, const uint64_t user_data) {
+        io_uring_sqe& sqe = queue(IORING_OP_WRITEV, handle, offset, user_data);
+        sqe.addr = (uint64_t) iov;
+        sqe.len = count;
+    }
+
+    // submission and completion; `callback(user_data, result)` gets called
+    // for each completed request, `result` being a byte count or -errno
+    inline void submit() {
+        while (_queued) {
+            const int submitted = syscall(__NR_io_uring_enter, _handle, _queued, 0, 0, NULL, 0);
+            if (submitted == -1) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                fatal("could not submit %u I/O requests (%s)", _queued, strerror(errno));
+            }
+            _queued -= submitted;
+            _in_flight += submitted;
+        }
+    }
+    // reap whatever completed, without waiting; returns the number of results
+    template <typename callback_t>
+    inline const unsigned poll(callback_t callback) {
+        unsigned head = *_cq_head;
+        const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        const unsigned count = tail - head;
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+            callback(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        _in_flight -= count;
+        return count;
+    }
+    // submit everything queued, then wait until it all completed
+    template <typename callback_t>
+    inline void wait(callback_t callback) {
+        submit();
+        while (_in_flight) {
+            if (poll(callback)) {
+                continue;
+            }
+            if (syscall(__NR_io_uring_enter, _handle, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) == -1 && errno != EINTR) {
+                fatal("could not wait for %u I/O requests (%s)", _in_flight, strerror(errno));
+            }
+        }
+    }
+
+    // internals
+    inline io_uring_sqe& queue(const uint8_t opcode, const int handle, const uint64_t offset, const uint64_t user_data) {
+        if (_queued + _in_flight >= _entries) {
+            fatal("more than %u I/O requests pending", _entries);
+        }
+        const unsigned tail = *_sq_tail;
+        const unsigned index = tail & *_sq_mask;
+        io_uring_sqe& sqe = _sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = opcode;
+        sqe.fd = handle;
+        sqe.off = offset;
+        sqe.user_data = user_data;
+        _sq_array[index] = index;
+        __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+        _queued++;
+        return sqe;
+    }
+
+};
+
+
+#endif // __INCLUDED__utils__uring_hpp__
@@ -0,0 +1,261 @@
+#ifndef __INCLUDED__utils__wal_hpp__
+#define __INCLUDED__utils__wal_hpp__
+
+
+#include "util/latches.hpp"
+#include "util/logging.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+
+// Write-ahead log: records are appended to a memory buffer, then written and
+// synced together, so that non-durable commits share the next sync. Logged
+// pagers are buffered, hence used from a single thread: there is no group
+// commit, only the checkpointer and the periodic flusher may sync alongside
+// it. Log sequence numbers (LSN) are byte positions in the log since its
+// creation; they keep growing when it gets truncated.
+
+template <typename size_t>
+struct WriteAheadLog {
+
+    enum {
+        WAL_PAGE = 1,
+        WAL_HEADER = 2,
+        WAL_COMMIT = 3,
+    };
+    struct file_header_t {
+        char magic[8];
+        uint64_t base_lsn;
+    };
+    struct record_t {
+        uint32_t type;
+        uint32_t size;
+        uint64_t page_index;
+        uint64_t checksum;
+    };
+
+    std::string _path;
+    int _handle;
+    uint64_t _base_lsn;
+    // records below `_written_lsn` are in the file, the others in `_buffer`
+    std::vector<char> _buffer;
+    uint64_t _written_lsn;
+    uint64_t _end_lsn;
+    // records below `_durable_lsn` are synced
+    uint64_t _durable_lsn;
+    pthread_mutex_t _mutex;
+    SyncStats _stats;
+
+    inline WriteAheadLog(const std::string& path) : _path(path) {
+        _handle = open(_path.c_str(), O_RDWR | O_CREAT, 0666);
+        if (_handle == -1) {
+            fatal("could not open: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        file_header_t file_header;
+        if (pread(_handle, &file_header, sizeof(file_header), 0) != sizeof(file_header) || memcmp(file_header.magic, "DUPAWAL", 8)) {
+            memcpy(file_header.magic, "DUPAWAL", 8);
+            file_header.base_lsn = 0;
+            write_file_header(file_header);
+        }
+        _base_lsn = file_header.base_lsn;
+        _written_lsn = _end_lsn = _durable_lsn = _base_lsn + file_size();
+        pthread_mutex_init(&_mutex, NULL);
+    }
+    inline ~WriteAheadLog() {
+        sync(_end_lsn);
+        pthread_mutex_destroy(&_mutex);
+        if (close(_handle) == -1) {
+            fatal("could not close: `%s`", _path.c_str());
+        }
+    }
+
+    // appending; returns the LSN of the record, its payload comes right after
+    inline const uint64_t append(const uint32_t type, const uint64_t page_index, const void* data, const uint32_t size) {
+        record_t record = {
+            .type = type,
+            .size = size,
+            .page_index = page_index,
+            .checksum = checksum(data, size) ^ (page_index * 0x9E3779B97F4A7C15ul) ^ type,
+        };
+        pthread_mutex_lock(&_mutex);
+        const uint64_t lsn = _end_lsn;
+        _buffer.insert(_buffer.end(), (const char*) &record, (const char*) &record + sizeof(record_t));
+        _buffer.insert(_buffer.end(), (const char*) data, (const char*) data + size);
+        _end_lsn += sizeof(record_t) + size;
+        // large buffers get written early, but not synced
+        if (_buffer.size() >= 4 * 1024 * 1024) {
+            write_buffer();
+        }
+        pthread_mutex_unlock(&_mutex);
+        return lsn;
+    }
+    inline const uint64_t end_lsn() {
+        pthread_mutex_lock(&_mutex);
+        const uint64_t lsn = _end_lsn;
+        pthread_mutex_unlock(&_mutex);
+        return lsn;
+    }
+    inline const uint64_t durable_lsn() {
+        pthread_mutex_lock(&_mutex);
+        const uint64_t lsn = _durable_lsn;
+        pthread_mutex_unlock(&_mutex);
+        return lsn;
+    }
+
+    // make every record before `lsn` durable
+    inline void sync(const uint64_t lsn) {
+        pthread_mutex_lock(&_mutex);
+        if (_durable_lsn >= lsn) {
+            pthread_mutex_unlock(&_mutex);
+            return;
+        }
+        // everything appended so far gets synced, without holding the mutex
+        write_buffer();
+        const uint64_t written_lsn = _written_lsn;
+        pthread_mutex_unlock(&_mutex);
+        _stats.time([&]() {
+            if (fdatasync(_handle) == -1) {
+                fatal("could not sync: `%s` (%s)", _path.c_str(), strerror(errno));
+            }
+        });
+        pthread_mutex_lock(&_mutex);
+        _durable_lsn = std::max(_durable_lsn, written_lsn);
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    // read a payload back, either from the file or from the buffer
+    inline void read(const uint64_t lsn, void* data, const uint32_t size) {
+        pthread_mutex_lock(&_mutex);
+        const uint64_t payload_lsn = lsn + sizeof(record_t);
+        if (payload_lsn >= _written_lsn) {
+            memcpy(data, _buffer.data() + (payload_lsn - _written_lsn), size);
+        } else if (pread(_handle, data, size, payload_lsn - _base_lsn) != size) {
+            fatal("could not read %u bytes at LSN %lu from: `%s` (%s)", size, payload_lsn, _path.c_str(), strerror(errno));
+        }
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    // recovery: every page and header record of committed batches from
+    // `start_lsn` on gets passed to `callback(record, lsn)`, in order; the
+    // torn tail, if any, is dropped
+    template <typename callback_t>
+    inline void recover(callback_t callback, const uint64_t start_lsn=0) {
+        auto ignore = [](const record_t& record, const uint64_t lsn) {};
+        const uint64_t committed_lsn = scan(ignore, start_lsn, _end_lsn);
+        scan(callback, start_lsn, committed_lsn);
+        if (committed_lsn < _end_lsn) {
+            warning("dropping %lu bytes of uncommitted log in: `%s`", _end_lsn - committed_lsn, _path.c_str());
+            if (ftruncate(_handle, committed_lsn - _base_lsn) == -1) {
+                fatal("could not truncate: `%s` (%s)", _path.c_str(), strerror(errno));
+            }
+            _written_lsn = _end_lsn = _durable_lsn = committed_lsn;
+        }
+    }
+    // release the space of the records before `lsn`, once they were applied;
+    // positions in the file do not change
+    inline void discard(const uint64_t lsn) {
+        pthread_mutex_lock(&_mutex);
+        const uint64_t begin = 4096;
+        const uint64_t end = (lsn > _base_lsn) ? ((lsn - _base_lsn) / 4096) * 4096 : 0;
+        if (end > begin && fallocate(_handle, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, begin, end - begin) == -1 && errno != EOPNOTSUPP) {
+            fatal("could not discard log records in: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        pthread_mutex_unlock(&_mutex);
+    }
+    // remove every record, once they were all applied
+    inline void truncate() {
+        sync(end_lsn());
+        pthread_mutex_lock(&_mutex);
+        if (ftruncate(_handle, sizeof(file_header_t)) == -1) {
+            fatal("could not truncate: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        file_header_t file_header;
+        memcpy(file_header.magic, "DUPAWAL", 8);
+        file_header.base_lsn = _base_lsn = _end_lsn - sizeof(file_header_t);
+        write_file_header(file_header);
+        if (fdatasync(_handle) == -1) {
+            fatal("could not sync: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        pthread_mutex_unlock(&_mutex);
+    }
+
+    // internals
+    static inline const uint64_t checksum(const void* data, const size_t size) {
+        uint64_t hash = 0xCBF29CE484222325ul ^ size;
+        const uint64_t* words = (const uint64_t*) data;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            hash = (hash ^ *words++) * 0x100000001B3ul;
+            hash ^= hash >> 29;
+        }
+        for (; i < size; i++) {
+            hash = (hash ^ ((const uint8_t*) data)[i]) * 0x100000001B3ul;
+        }
+        return hash;
+    }
+    inline const uint64_t file_size() {
+        const off_t size = lseek(_handle, 0, SEEK_END);
+        if (size == -1) {
+            fatal("could not seek in: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        return size;
+    }
+    inline void write_file_header(const file_header_t& file_header) {
+        if (pwrite(_handle, &file_header, sizeof(file_header), 0) != sizeof(file_header)) {
+            fatal("could not write to: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+    }
+    inline void write_buffer() {
+        if (_buffer.empty()) {
+            return;
+        }
+        if (pwrite(_handle, _buffer.data(), _buffer.size(), _written_lsn - _base_lsn) != _buffer.size()) {
+            fatal("could not write to: `%s` (%s)", _path.c_str(), strerror(errno));
+        }
+        _written_lsn += _buffer.size();
+        _buffer.clear();
+    }
+    // walk through valid records between `start_lsn` and `stop_lsn`; returns
+    // the LSN right after the last commit
+    template <typename callback_t>
+    inline const uint64_t scan(callback_t& callback, const uint64_t start_lsn, const uint64_t stop_lsn) {
+        uint64_t lsn = std::max<uint64_t>(start_lsn, _base_lsn + sizeof(file_header_t));
+        uint64_t committed_lsn = lsn;
+        std::vector<char> payload;
+        record_t record;
+        while (lsn < stop_lsn && pread(_handle, &record, sizeof(record), lsn - _base_lsn) == sizeof(record)) {
+            // sizes read from a torn tail may be anything
+            if (record.size > (1 << 30) || lsn + sizeof(record) + record.size > stop_lsn) {
+                break;
+            }
+            payload.resize(record.size);
+            if (pread(_handle, payload.data(), record.size, lsn - _base_lsn + sizeof(record)) != record.size) {
+                break;
+            }
+            if (record.checksum != (checksum(payload.data(), record.size) ^ (record.page_index * 0x9E3779B97F4A7C15ul) ^ record.type)) {
+                break;
+            }
+            if (record.type != WAL_COMMIT) {
+                callback(record, lsn);
+            }
+            lsn += sizeof(record) + record.size;
+            if (record.type == WAL_COMMIT) {
+                committed_lsn = lsn;
+            }
+        }
+        return committed_lsn;
+    }
+
+};
+
+
+#endif // __INCLUDED__utils__wal_hpp__
@@ -1,6 +1,37 @@
 #include "DupaDB.hpp"
 #include "util/logging.hpp"
 
+#include <vector>
+
+#include <pthread.h>
+
+
+static const uint64_t threads_count = 4;
+static const uint64_t appends_count = 1024 * 1024;
+static Counter<uint64_t, uint64_t, 4096, 256>* shared;
+static uint64_t unpublished_count = 0;
+
+// each thread appends its own increasing sequence: thread number in the
+// upper bits, rank in the lower ones
+void* append(void* arg) {
+    const uint64_t t = (uint64_t) arg;
+    for (uint64_t i=0; i<appends_count; i++) {
+        shared->append((t << 32) | (i + 1));
+    }
+    return NULL;
+}
+// published values should never be seen before they are written
+void* watch(void* arg) {
+    const uint64_t total = threads_count * appends_count;
+    uint64_t published;
+    while ((published = shared->published()) < total) {
+        if (published && shared->get(published) == 0) {
+            unpublished_count++;
+        }
+    }
+    return NULL;
+}
+
 
 int main(int argc, char const *argv[]) {
     start();
@@ -23,5 +54,75 @@ int main(int argc, char const *argv[]) {
         counter.append(value);
     }
 
+    Counter<uint64_t, uint64_t, 4096, 256> mapped("storage/test_1c", 16*1024*1024, FILEPAGER_MAPPED);
+    message("insert %u things in mapped pages", n);
+    uint64_t first = mapped.header->counter + 1;
+    for (uint64_t i=0; i<n; i++) {
+        mapped.append(i);
+    }
+    message("check mapped pages");
+    for (uint64_t i=0; i<n; i++) {
+        if (mapped.get(first + i) != i) {
+            error("%lu != %lu", mapped.get(first + i), i);
+            break;
+        }
+    }
+
+    unlink("storage/test_1d");
+    shared = new Counter<uint64_t, uint64_t, 4096, 256>("storage/test_1d", 16*1024*1024, FILEPAGER_MAPPED);
+    message("append %lu things from %lu threads", threads_count * appends_count, threads_count);
+    pthread_t threads[threads_count + 1];
+    pthread_create(threads + threads_count, NULL, watch, NULL);
+    for (uint64_t t=0; t<threads_count; t++) {
+        pthread_create(threads + t, NULL, append, (void*) t);
+    }
+    for (uint64_t t=0; t<=threads_count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    message("check appended things");
+    if (unpublished_count) {
+        error("%lu values were published before being written", unpublished_count);
+    }
+    if (shared->published() != threads_count * appends_count) {
+        error("%lu values published instead of %lu", shared->published(), threads_count * appends_count);
+    }
+    uint64_t ranks[threads_count] = {0};
+    for (uint64_t identifier=1; identifier<=shared->published(); identifier++) {
+        const uint64_t value = shared->get(identifier);
+        const uint64_t t = value >> 32;
+        if (t >= threads_count || (value & 0xFFFFFFFF) != ++ranks[t]) {
+            error("unexpected value #%lu: %lx", identifier, value);
+            break;
+        }
+    }
+    delete shared;
+
+    unlink("storage/test_1e");
+    Counter<uint64_t, uint64_t, 4096, 256> batched("storage/test_1e", 16*1024*1024);
+    message("insert %u things in batches", n);
+    std::vector<uint64_t> batch(1000);
+    for (uint64_t i=0; i<n; i+=batch.size()) {
+        const uint64_t count = std::min<uint64_t>(batch.size(), n - i);
+        for (uint64_t j=0; j<count; j++) {
+            batch[j] = i + j;
+        }
+        // both overloads, one batch each
+        if ((i / batch.size()) % 2) {
+            batched.append_many(batch.data(), count);
+        } else {
+            batched.append_many(batch.begin(), batch.begin() + count);
+        }
+    }
+    message("check batched things");
+    if (batched.published() != n) {
+        error("%lu values published instead of %u", batched.published(), n);
+    }
+    for (uint64_t i=0; i<n; i++) {
+        if (batched.get(i + 1) != i) {
+            error("%lu != %lu", batched.get(i + 1), i);
+            break;
+        }
+    }
+
     finish(return);
 }
@@ -4,6 +4,8 @@
 
 #include "BTree.hpp"
 
+#include <vector>
+
 
 
 int main(int argc, char const *argv[]) {
@@ -13,6 +15,7 @@ int main(int argc, char const *argv[]) {
     uint64_t n = 1024 * 1024;
 
     message("initialize BTree");
+    unlink("storage/test_2");
     BTree<uint32_t, str_t<>> btree("storage/test_2");
     notice("%u keys per page", btree.max_keys_count);
     notice("%lu bytes per page", sizeof(BTreePage<uint32_t, str_t<>, 4096>));
@@ -35,5 +38,138 @@ int main(int argc, char const *argv[]) {
         finish(return);
     }
 
+    message("find each key");
+    for (uint64_t value=0; value<n; value++) {
+        key = number2expression(value);
+        auto it = btree.find(key);
+        if (!(it != btree.end()) || it.value() != value) {
+            error("could not find `%s`", key.data());
+            finish(return);
+        }
+    }
+    notice("release clean frames, then find each key again");
+    btree.flush();
+    notice("%u frames released", btree.trim());
+    for (uint64_t value=0; value<n; value++) {
+        key = number2expression(value);
+        auto it = btree.find(key);
+        if (!(it != btree.end()) || it.value() != value) {
+            error("could not find `%s` after releasing frames", key.data());
+            finish(return);
+        }
+    }
+    message("browse backwards");
+    uint64_t count = 0;
+    str_t<> previous_key;
+    for (auto it=btree.rbegin(); it!=btree.rend(); ++it) {
+        if (count++ && previous_key < it.key()) {
+            error("ORDER ERROR: %s < %s", previous_key.data(), it.key().data());
+            finish(return);
+        }
+        previous_key = it.key();
+    }
+    if (count != n) {
+        error("COUNT ERROR: %lu != %lu", count, n);
+    }
+
+    message("scan range");
+    str_t<> lo = "five";
+    str_t<> hi = "six";
+    uint64_t expected_count = 0;
+    for (auto it=key2value.begin(); it!=key2value.end(); it++) {
+        expected_count += (lo <= it->first && it->first < hi);
+    }
+    count = btree.scan(lo, hi, [&](const str_t<>& key, const uint32_t value) {
+        return lo <= key && key < hi && key2value[key] == value;
+    });
+    if (count != expected_count) {
+        error("COUNT ERROR: %lu != %lu", count, expected_count);
+    }
+
+    notice("find missing keys");
+    key = "zero and a half";
+    if (btree.find(key) != btree.end()) {
+        error("found `%s`", key.data());
+    }
+    auto range = btree.equal_range(key);
+    if (range.first != range.second) {
+        error("non-empty range for `%s`", key.data());
+    }
+
+    message("bulk load");
+    unlink("storage/test_2b");
+    BTree<uint32_t, str_t<>> loaded_btree("storage/test_2b");
+    loaded_btree.load_unsorted(key2value.begin(), key2value.end(), 1.0, 256 * 1024);
+    notice("%u pages instead of %u", loaded_btree.header->page_count, btree.header->page_count);
+    notice("compare map with bulk loaded BTree");
+    if (!loaded_btree.show_check(key2value) || !loaded_btree.check()) {
+        error("bulk loaded BTree differs");
+    }
+    for (uint64_t value=0; value<n; value+=97) {
+        key = number2expression(value);
+        auto it = loaded_btree.find(key);
+        if (!(it != loaded_btree.end()) || it.value() != value) {
+            error("could not find `%s`", key.data());
+            finish(return);
+        }
+    }
+
+    message("bulk load, then erase");
+    typedef BTree<uint32_t, uint64_t> numbers_btree_t;
+    const uint64_t m = numbers_btree_t::max_keys_count;
+    // the last leaf, or the last internal page, would be left almost empty
+    const uint64_t sizes[] = {m + 1, m * (m + 1), m * (m + 1) + 1, m * (m + 1) + m / 2};
+    for (const uint64_t size : sizes) {
+        unlink("storage/test_2c");
+        numbers_btree_t numbers_btree("storage/test_2c");
+        std::vector<std::pair<uint64_t, uint32_t>> entries;
+        for (uint64_t k=0; k<size; k++) {
+            entries.push_back(std::pair<uint64_t, uint32_t>(k, k));
+        }
+        numbers_btree.load(entries.begin(), entries.end());
+        if (!numbers_btree.check()) {
+            error("bulk loaded BTree of %lu keys is unbalanced", size);
+            continue;
+        }
+        // from the largest key
+        for (uint64_t k=size; k--; ) {
+            if (!numbers_btree.erase(k)) {
+                error("could not erase %lu from %lu keys", k, size);
+                break;
+            }
+            if (k == size - 1 && !numbers_btree.check()) {
+                error("BTree of %lu keys differs after erasing", size);
+            }
+        }
+        if (numbers_btree.begin() != numbers_btree.end()) {
+            error("keys remain in BTree of %lu keys", size);
+        }
+    }
+
+    message("erase half of the keys");
+    for (uint64_t value=0; value<n; value+=2) {
+        key = number2expression(value);
+        if (!btree.erase(key)) {
+            error("could not erase `%s`", key.data());
+            finish(return);
+        }
+        key2value.erase(key);
+    }
+    notice("compare map with BTree");
+    if (!btree.show_check(key2value) || !btree.check()) {
+        error("BTree differs after erasing");
+    }
+    notice("insert them back");
+    uint32_t page_count = btree.header->page_count;
+    for (uint64_t value=0; value<n; value+=2) {
+        key = number2expression(value);
+        btree.insert(key, value);
+        key2value[key] = value;
+    }
+    notice("%u pages instead of %u", btree.header->page_count, page_count);
+    if (!btree.show_check(key2value)) {
+        error("BTree differs after inserting back");
+    }
+
     finish(return);
 }
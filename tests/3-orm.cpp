@@ -4,6 +4,8 @@
 
 #include "Counter.hpp"
 #include "BTree.hpp"
+#include "StringBTree.hpp"
+#include "HashIndex.hpp"
 
 #include <stdint.h>
 #include <stdlib.h>
@@ -83,12 +85,12 @@ struct EntityType {
 struct EntityType::DB {
     // indices
     Counter<EntityType, uint32_t, 4096, 256> primary;
-    BTree<uint32_t, str_t<32>> btree__name;
+    HashIndex<uint32_t, str_t<32>> hash__name;
 
     // constructor
     inline DB(std::string path) :
         primary((path + ".primary").c_str(), 1024*1024),
-        btree__name((path + ".btree.name").c_str()) {}
+        hash__name((path + ".hash.name").c_str()) {}
     // add an element to all indices
     inline bool add(EntityType& entity_type) {
         // primary index
@@ -97,8 +99,8 @@ struct EntityType::DB {
             return false;
         }
         entity_type.id = id;
-        // btree index: (name)
-        btree__name.insert(
+        // hash index: (name)
+        hash__name.insert(
             entity_type.name,
             id
         );
@@ -133,7 +135,7 @@ struct Entity::DB {
     Counter<Entity, uint32_t, 4096, 256> primary;
     BTree<uint32_t, std::tuple<char, str_t<16>>> btree__type_id__name;
     BTree<uint32_t, std::tuple<str_t<16>, char>> btree__name__type_id;
-    BTree<uint32_t, str_t<256>> btree__description;
+    StringBTree<uint32_t, 256> btree__description;
 
     // constructor
     inline DB(std::string path) :
@@ -274,6 +276,16 @@ int main(int argc, char const *argv[]) {
         }
     }
 
+    message("find entities by index: description") {
+        auto& index = db.entities.btree__description;
+        str_t<256> description = db.entities.primary.get(1).description;
+        auto range = index.equal_range(description);
+        for (auto it=range.first; it!=range.second; ++it) {
+            size_t id = it.value();
+            db.entities.primary.get(id).show();
+        }
+    }
+
     message("query with ORM") {
         auto query = db
           .select<Entity>()
@@ -0,0 +1,176 @@
+#include "util/logging.hpp"
+#include "util/generators.hpp"
+
+#include "BTree.hpp"
+
+#include <atomic>
+
+#include <pthread.h>
+
+
+typedef BTree<uint32_t, uint64_t, 64*1024*1024> btree_t;
+
+static const uint32_t writers_count = 4;
+static const uint32_t readers_count = 4;
+static const uint64_t n = 1024 * 1024;
+
+static btree_t* btree;
+// number of keys inserted so far by each writer
+static std::atomic<uint64_t> progress[writers_count];
+static std::atomic<bool> is_running;
+static std::atomic<uint64_t> errors_count;
+static std::atomic<uint64_t> lookups_count;
+static std::atomic<uint64_t> scans_count;
+
+
+// writer `w` inserts keys w, w + writers_count, w + 2 * writers_count...
+static inline const uint64_t make_key(const uint64_t w, const uint64_t i) {
+    return i * writers_count + w;
+}
+
+static void* writer(void* arg) {
+    const uint64_t w = (uint64_t) arg;
+    for (uint64_t i=0; i<n/writers_count; i++) {
+        const uint64_t key = make_key(w, i);
+        btree->insert(key, key % 1000003);
+        progress[w].store(i + 1, std::memory_order_release);
+    }
+    return NULL;
+}
+
+// readers look up keys that are known to be there already, and check that
+// scans are sorted
+static void* reader(void* arg) {
+    uint64_t seed = (uint64_t) arg;
+    while (is_running.load()) {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        const uint64_t w = (seed >> 33) % writers_count;
+        const uint64_t inserted = progress[w].load(std::memory_order_acquire);
+        if (inserted == 0) {
+            continue;
+        }
+        const uint64_t key = make_key(w, (seed >> 13) % inserted);
+        auto it = btree->find(key);
+        if (!(it != btree->end()) || it.key() != key || it.value() != key % 1000003) {
+            errors_count++;
+        }
+        if (++lookups_count % 64 == 0) {
+            uint64_t previous_key = 0;
+            uint64_t count = 0;
+            btree->scan(key, key + 4096, [&](const uint64_t& k, const uint32_t& v) {
+                if ((count++ && k <= previous_key) || k < key || v != k % 1000003) {
+                    errors_count++;
+                }
+                previous_key = k;
+                return true;
+            });
+            scans_count++;
+        }
+    }
+    return NULL;
+}
+
+// while keys get erased, the odd ones should always be found
+static void* odd_reader(void* arg) {
+    uint64_t seed = (uint64_t) arg;
+    while (is_running.load()) {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        const uint64_t key = 2 * ((seed >> 13) % (n / 2)) + 1;
+        auto it = btree->find(key);
+        if (!(it != btree->end()) || it.key() != key) {
+            errors_count++;
+        }
+        lookups_count++;
+    }
+    return NULL;
+}
+
+static void* even_eraser(void* arg) {
+    for (uint64_t key=0; key<n; key+=2) {
+        btree->erase(key);
+    }
+    return NULL;
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("initialize mapped BTree");
+    unlink("storage/test_4");
+    btree = new btree_t("storage/test_4", FILEPAGER_MAPPED);
+    pthread_t writers[writers_count];
+    pthread_t readers[readers_count];
+
+    message("insert with %u writers and %u readers", writers_count, readers_count);
+    is_running = true;
+    for (uint64_t r=0; r<readers_count; r++) {
+        pthread_create(readers + r, NULL, reader, (void*) (r + 1));
+    }
+    for (uint64_t w=0; w<writers_count; w++) {
+        pthread_create(writers + w, NULL, writer, (void*) w);
+    }
+    for (uint32_t w=0; w<writers_count; w++) {
+        pthread_join(writers[w], NULL);
+    }
+    is_running = false;
+    for (uint32_t r=0; r<readers_count; r++) {
+        pthread_join(readers[r], NULL);
+    }
+    notice("%lu lookups, %lu scans", lookups_count.load(), scans_count.load());
+    if (errors_count) {
+        error("%lu errors while reading", errors_count.load());
+        finish(return);
+    }
+
+    message("check the tree");
+    if (!btree->check()) {
+        error("keys are not sorted");
+        finish(return);
+    }
+    uint64_t count = 0;
+    for (auto it=btree->begin(); it!=btree->end(); ++it) {
+        if (it.key() != count) {
+            error("expected key %lu, found %lu", count, it.key());
+            finish(return);
+        }
+        count++;
+    }
+    if (count != n) {
+        error("COUNT ERROR: %lu != %lu", count, n);
+        finish(return);
+    }
+
+    message("erase even keys with %u readers", readers_count);
+    lookups_count = 0;
+    is_running = true;
+    for (uint64_t r=0; r<readers_count; r++) {
+        pthread_create(readers + r, NULL, odd_reader, (void*) (r + 1));
+    }
+    pthread_create(writers, NULL, even_eraser, NULL);
+    pthread_join(writers[0], NULL);
+    is_running = false;
+    for (uint32_t r=0; r<readers_count; r++) {
+        pthread_join(readers[r], NULL);
+    }
+    notice("%lu lookups", lookups_count.load());
+    if (errors_count) {
+        error("%lu errors while reading", errors_count.load());
+        finish(return);
+    }
+    count = 0;
+    for (auto it=btree->begin(); it!=btree->end(); ++it) {
+        if (it.key() != 2 * count + 1) {
+            error("expected key %lu, found %lu", 2 * count + 1, it.key());
+            finish(return);
+        }
+        count++;
+    }
+    if (count != n / 2) {
+        error("COUNT ERROR: %lu != %lu", count, n / 2);
+    }
+
+    delete btree;
+    finish(return);
+}
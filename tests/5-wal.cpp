@@ -0,0 +1,119 @@
+#include "util/logging.hpp"
+#include "util/generators.hpp"
+
+#include "BTree.hpp"
+
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+typedef BTree<uint32_t, uint64_t> btree_t;
+
+static const char* path = "storage/test_5";
+static const uint64_t committed_count = 200 * 1000;
+static const uint64_t uncommitted_count = 400 * 1000;
+
+
+// insert and commit keys, insert more without committing, then crash; the
+// recovered tree should hold exactly the committed keys, even when the log
+// ends with a garbage record
+bool crash_and_recover(const uint64_t checkpoint_size, const bool has_garbage_tail=false) {
+    unlink(path);
+    unlink((std::string(path) + ".wal").c_str());
+    pid_t pid = fork();
+    if (pid == 0) {
+        btree_t btree(path, FILEPAGER_LOGGED);
+        btree.set_durability(DURABILITY_OPERATIONS, 10);
+        btree.set_checkpoint_size(checkpoint_size);
+        for (uint64_t key=0; key<committed_count; key++) {
+            btree.insert(key, key);
+            if (key % 1000 == 999) {
+                btree.commit();
+            }
+        }
+        btree.commit();
+        btree.sync();
+        // evicted pages get logged, but are never committed
+        for (uint64_t key=committed_count; key<committed_count+uncommitted_count; key++) {
+            btree.insert(key, key);
+        }
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    if (has_garbage_tail) {
+        const int handle = open((std::string(path) + ".wal").c_str(), O_WRONLY | O_APPEND);
+        const uint32_t garbage[6] = {1, 0xfffffff0u, 0, 0, 0, 0};
+        if (handle == -1 || write(handle, garbage, sizeof(garbage)) != sizeof(garbage)) {
+            error("could not append garbage to the log");
+            return false;
+        }
+        close(handle);
+    }
+
+    btree_t btree(path, FILEPAGER_LOGGED);
+    if (!btree.check()) {
+        error("keys are not sorted");
+        return false;
+    }
+    uint64_t count = 0;
+    for (auto it=btree.begin(); it!=btree.end(); ++it) {
+        if (it.key() != count || it.value() != count) {
+            error("expected key %lu, found %lu -> %u", count, it.key(), it.value());
+            return false;
+        }
+        count++;
+    }
+    if (count != committed_count) {
+        error("COUNT ERROR: %lu != %lu", count, committed_count);
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("insert %lu keys, commit, insert %lu more, crash and recover", committed_count, uncommitted_count);
+    if (!crash_and_recover(1024 * 1024 * 1024)) {
+        finish(return);
+    }
+    message("same with background checkpoints every MiB of log");
+    if (!crash_and_recover(1024 * 1024)) {
+        finish(return);
+    }
+    message("same with a garbage record at the end of the log");
+    if (!crash_and_recover(1024 * 1024 * 1024, true)) {
+        finish(return);
+    }
+
+    message("commit throughput");
+    static const uint64_t n = 2000;
+    btree_t btree(path, FILEPAGER_LOGGED);
+    uint64_t key = committed_count;
+    const char* names[] = {"none", "periodic (10 ms)", "every 100 commits", "every commit"};
+    const uint64_t parameters[] = {0, 10, 100, 0};
+    for (int durability=DURABILITY_NONE; durability<=DURABILITY_COMMIT; durability++) {
+        btree.set_durability(durability, parameters[durability]);
+        const commit_stats_t before = btree.commit_stats();
+        const double t0 = millitime();
+        for (uint64_t i=0; i<n; i++, key++) {
+            btree.insert(key, key);
+            btree.commit();
+        }
+        btree.sync();
+        const double t1 = millitime();
+        const commit_stats_t after = btree.commit_stats();
+        const uint64_t syncs_count = after.syncs_count - before.syncs_count;
+        notice("%-18s %8.0f commits/s, %4lu syncs, %6.3f ms per sync",
+            names[durability], n / (t1 - t0), syncs_count,
+            syncs_count ? 1e3 * (after.sync_latency * after.syncs_count - before.sync_latency * before.syncs_count) / syncs_count : 0.0
+        );
+    }
+    const commit_stats_t stats = btree.commit_stats();
+    notice("%lu commits, %lu syncs, %.3f ms max sync latency", stats.commits_count, stats.syncs_count, 1e3 * stats.sync_max_latency);
+
+    finish(return);
+}
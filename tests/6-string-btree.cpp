@@ -0,0 +1,232 @@
+#include "util/logging.hpp"
+#include "util/types.hpp"
+
+#include "BTree.hpp"
+#include "StringBTree.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+
+typedef str_t<256> string_t;
+typedef StringBTree<uint32_t, 256> string_btree_t;
+typedef str_t<8192> long_string_t;
+typedef StringBTree<uint32_t, 8192> long_string_btree_t;
+typedef BTree<uint32_t, string_t> btree_t;
+
+static const uint32_t n = 256 * 1024;
+static const uint32_t long_n = 16 * 1024;
+
+
+// keys sharing long prefixes, like paths or URLs
+static inline void make_key(string_t& key, const uint32_t value) {
+    snprintf(key._data, sizeof(key._data), "https://dupadb.example/users/%06u/posts/%04u", (value * 2654435761u) % n / 16, value % 16);
+}
+
+// keys from a few bytes to a few pages long, most of them in overflow pages,
+// and sharing more than what stays inline
+static inline void make_long_key(long_string_t& key, const uint32_t value) {
+    const uint32_t head_size = (value % 8) * 1000;
+    const uint32_t tail_size = (value * 31) % 500;
+    memset(key._data, 'a', head_size);
+    snprintf(key._data + head_size, 16, "#%06u", (value * 2654435761u) % long_n);
+    memset(key._data + head_size + 7, 'z', tail_size);
+    key._data[head_size + 7 + tail_size] = 0;
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+    string_t key;
+
+    message("initialize string BTree");
+    unlink("storage/test_6");
+    string_btree_t btree("storage/test_6");
+
+    message("insert %u keys", n);
+    std::vector<std::pair<std::string, uint32_t>> expected;
+    for (uint32_t value=0; value<n; value++) {
+        make_key(key, value);
+        btree.insert(key, value);
+        expected.push_back(std::pair<std::string, uint32_t>(key.data(), value));
+    }
+    std::stable_sort(expected.begin(), expected.end(), [](const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b) {
+        return a.first < b.first;
+    });
+    if (!btree.check()) {
+        error("string BTree is inconsistent");
+        finish(return);
+    }
+
+    message("browse in order");
+    uint32_t count = 0;
+    for (auto it=btree.begin(); it!=btree.end(); ++it, count++) {
+        if (count >= n || expected[count].first != it.key().data()) {
+            error("expected `%s`, found `%s`", expected[count].first.c_str(), it.key().data());
+            finish(return);
+        }
+    }
+    if (count != n) {
+        error("COUNT ERROR: %u != %u", count, n);
+    }
+
+    message("find each key");
+    for (uint32_t value=0; value<n; value++) {
+        make_key(key, value);
+        auto it = btree.find(key);
+        if (!(it != btree.end()) || !(it.key() == key)) {
+            error("could not find `%s`", key.data());
+            finish(return);
+        }
+    }
+    notice("find missing keys");
+    for (uint32_t value=0; value<n; value+=1024) {
+        make_key(key, value);
+        strcat(key._data, "!");
+        if (btree.find(key) != btree.end()) {
+            error("found missing key `%s`", key.data());
+        }
+    }
+
+    message("duplicates");
+    key = "https://dupadb.example/duplicate";
+    for (uint32_t i=0; i<5000; i++) {
+        btree.insert(key, i);
+    }
+    auto range = btree.equal_range(key);
+    count = 0;
+    for (auto it=range.first; it!=range.second; ++it) {
+        count++;
+    }
+    if (count != 5000) {
+        error("COUNT ERROR: %u != 5000 duplicates", count);
+    }
+    notice("erase them");
+    for (uint32_t i=0; i<5000; i++) {
+        if (!btree.erase(key, i)) {
+            error("could not erase duplicate %u", i);
+            finish(return);
+        }
+    }
+    if (btree.find(key) != btree.end() || !btree.check()) {
+        error("duplicates remain after erasing them");
+    }
+
+    message("reopen");
+    const uint32_t page_count = btree.header->page_count;
+    btree.flush();
+    {
+        string_btree_t reopened("storage/test_6");
+        count = 0;
+        for (auto it=reopened.begin(); it!=reopened.end(); ++it) {
+            count++;
+        }
+        if (count != n || !reopened.check()) {
+            error("COUNT ERROR after reopening: %u != %u", count, n);
+        }
+    }
+
+    message("insert %u long keys", long_n);
+    unlink("storage/test_6_long");
+    {
+        long_string_btree_t long_btree("storage/test_6_long");
+        long_string_t long_key;
+        std::vector<std::pair<std::string, uint32_t>> long_expected;
+        for (uint32_t value=0; value<long_n; value++) {
+            make_long_key(long_key, value);
+            long_btree.insert(long_key, value);
+            long_expected.push_back(std::pair<std::string, uint32_t>(long_key.data(), value));
+        }
+        std::stable_sort(long_expected.begin(), long_expected.end(), [](const std::pair<std::string, uint32_t>& a, const std::pair<std::string, uint32_t>& b) {
+            return a.first < b.first;
+        });
+        notice("%u pages, %u in overflow", long_btree.header->page_count, long_btree.header->overflow_pages_count);
+        if (!long_btree.check()) {
+            error("string BTree with long keys is inconsistent");
+            finish(return);
+        }
+        count = 0;
+        for (auto it=long_btree.begin(); it!=long_btree.end(); ++it, count++) {
+            if (count >= long_n || long_expected[count].first != it.key().data() || long_expected[count].second != it.value()) {
+                error("long key #%u is out of order", count);
+                finish(return);
+            }
+        }
+        if (count != long_n) {
+            error("COUNT ERROR: %u != %u long keys", count, long_n);
+        }
+        notice("find them");
+        for (uint32_t value=0; value<long_n; value++) {
+            make_long_key(long_key, value);
+            auto it = long_btree.find(long_key);
+            if (!(it != long_btree.end()) || it.value() != value) {
+                error("could not find long key #%u", value);
+                finish(return);
+            }
+            strcat(long_key._data, "!");
+            if (long_btree.find(long_key) != long_btree.end()) {
+                error("found missing long key #%u", value);
+                finish(return);
+            }
+        }
+        notice("erase half of them, and insert them again");
+        const uint32_t overflow_pages_count = long_btree.header->overflow_pages_count;
+        for (uint32_t value=0; value<long_n; value+=2) {
+            make_long_key(long_key, value);
+            if (!long_btree.erase(long_key)) {
+                error("could not erase long key #%u", value);
+                finish(return);
+            }
+        }
+        const uint32_t page_count = long_btree.header->page_count;
+        for (uint32_t value=0; value<long_n; value+=2) {
+            make_long_key(long_key, value);
+            long_btree.insert(long_key, value);
+        }
+        if (long_btree.header->overflow_pages_count != overflow_pages_count || long_btree.header->page_count != page_count) {
+            error("overflow pages of erased keys were not reused");
+        }
+        notice("duplicates");
+        make_long_key(long_key, 7);
+        for (uint32_t i=0; i<1000; i++) {
+            long_btree.insert(long_key, i);
+        }
+        auto long_range = long_btree.equal_range(long_key);
+        count = 0;
+        for (auto it=long_range.first; it!=long_range.second; ++it) {
+            count++;
+        }
+        if (count != 1001 || !long_btree.check()) {
+            error("COUNT ERROR: %u != 1001 long duplicates", count);
+        }
+    }
+
+    message("compare with a fixed-width BTree");
+    unlink("storage/test_6_fixed");
+    btree_t fixed_btree("storage/test_6_fixed");
+    for (uint32_t value=0; value<n; value++) {
+        make_key(key, value);
+        fixed_btree.insert(key, value);
+    }
+    notice("%u pages instead of %u", page_count, fixed_btree.header->page_count);
+    double t0 = millitime();
+    for (uint32_t value=0; value<n; value++) {
+        make_key(key, value);
+        btree.find(key);
+    }
+    double t1 = millitime();
+    notice("%.0f lookups/s with prefix compression", n / (t1 - t0));
+    t0 = millitime();
+    for (uint32_t value=0; value<n; value++) {
+        make_key(key, value);
+        fixed_btree.find(key);
+    }
+    t1 = millitime();
+    notice("%.0f lookups/s with fixed-width keys", n / (t1 - t0));
+
+    finish(return);
+}
@@ -0,0 +1,188 @@
+#include "util/logging.hpp"
+#include "util/types.hpp"
+
+#include "RadixTree.hpp"
+#include "StringBTree.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+
+typedef str_t<256> string_t;
+typedef RadixTree<uint32_t, 256> radix_tree_t;
+typedef StringBTree<uint32_t, 256> string_btree_t;
+
+static const uint32_t n = 256 * 1024;
+
+
+// distinct keys sharing long prefixes, like paths or URLs
+static inline void make_key(string_t& key, const uint32_t value) {
+    const uint32_t x = (value * 2654435761u) % n;
+    snprintf(key._data, sizeof(key._data), "https://dupadb.example/users/%06u/posts/%04u", x / 16, x % 16);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+    string_t key;
+    uint32_t value;
+    uint32_t count;
+
+    message("initialize radix tree");
+    unlink("storage/test_7");
+    radix_tree_t tree("storage/test_7");
+
+    message("insert %u keys", n);
+    std::vector<std::string> expected;
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        if (!tree.insert(key, v)) {
+            error("`%s` was already there", key.data());
+            finish(return);
+        }
+        expected.push_back(key.data());
+    }
+    std::sort(expected.begin(), expected.end());
+    if (tree.keys_count() != n || !tree.check()) {
+        error("radix tree is inconsistent");
+        finish(return);
+    }
+    notice("insert duplicates");
+    make_key(key, 123);
+    tree.insert(key, n);
+    tree.insert(key, n + 1);
+    std::vector<uint32_t> values;
+    tree.find(key, [&values](const uint32_t value) {
+        values.push_back(value);
+        return true;
+    });
+    if (values.size() != 3 || values[0] != 123 || values[1] != n || values[2] != n + 1 || tree.keys_count() != n + 2 || !tree.check()) {
+        error("could not insert duplicates of `%s`", key.data());
+        finish(return);
+    }
+    count = tree.scan(key, [](const string_t& key, const uint32_t value) {
+        return true;
+    });
+    if (count != 3) {
+        error("COUNT ERROR: %u != 3 duplicates", count);
+    }
+    if (!tree.erase(key, 123) || !tree.erase(key, n + 1) || tree.erase(key, n + 1) || !tree.find(key, value) || value != n) {
+        error("could not erase duplicates of `%s`", key.data());
+    }
+    tree.erase(key);
+    tree.insert(key, 123);
+    if (tree.keys_count() != n || !tree.check()) {
+        error("radix tree is inconsistent after erasing duplicates");
+        finish(return);
+    }
+
+    message("browse in order");
+    count = 0;
+    tree.scan([&](const string_t& key, const uint32_t value) {
+        if (count >= n || expected[count] != key.data()) {
+            error("expected `%s`, found `%s`", expected[count].c_str(), key.data());
+            return false;
+        }
+        count++;
+        return true;
+    });
+    if (count != n) {
+        error("COUNT ERROR: %u != %u", count, n);
+    }
+    notice("browse by prefix");
+    count = tree.scan(string_t("https://dupadb.example/users/000123/"), [&](const string_t& key, const uint32_t value) {
+        return true;
+    });
+    if (count != 16) {
+        error("COUNT ERROR: %u != 16 keys with prefix", count);
+    }
+
+    message("find each key");
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        if (!tree.find(key, value) || value != v) {
+            error("could not find `%s`", key.data());
+            finish(return);
+        }
+    }
+    notice("find missing keys");
+    for (uint32_t v=0; v<n; v+=1024) {
+        make_key(key, v);
+        key._data[strlen(key._data) - 1] = 0;
+        if (tree.contains(key)) {
+            error("found missing key `%s`", key.data());
+        }
+        make_key(key, v);
+        strcat(key._data, "!");
+        if (tree.contains(key)) {
+            error("found missing key `%s`", key.data());
+        }
+    }
+
+    message("erase every other key");
+    for (uint32_t v=0; v<n; v+=2) {
+        make_key(key, v);
+        if (!tree.erase(key)) {
+            error("could not erase `%s`", key.data());
+            finish(return);
+        }
+    }
+    if (tree.keys_count() != n / 2 || !tree.check()) {
+        error("radix tree is inconsistent after erasing");
+        finish(return);
+    }
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        if (tree.contains(key) != (v % 2 == 1)) {
+            error("`%s` should%s be there", key.data(), (v % 2) ? "" : " not");
+            finish(return);
+        }
+    }
+    notice("insert them again");
+    for (uint32_t v=0; v<n; v+=2) {
+        make_key(key, v);
+        tree.insert(key, v);
+    }
+
+    message("reopen");
+    tree.flush();
+    const uint32_t page_count = tree.header->page_count;
+    {
+        radix_tree_t reopened("storage/test_7");
+        count = reopened.scan([](const string_t& key, const uint32_t value) {
+            return true;
+        });
+        if (count != n || !reopened.check()) {
+            error("COUNT ERROR after reopening: %u != %u", count, n);
+        }
+    }
+
+    message("compare with a string BTree");
+    unlink("storage/test_7_btree");
+    string_btree_t btree("storage/test_7_btree");
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        btree.insert(key, v);
+    }
+    notice("%u pages instead of %u", page_count, btree.header->page_count);
+    double t0 = millitime();
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        tree.find(key, value);
+    }
+    double t1 = millitime();
+    notice("%.0f lookups/s with the radix tree", n / (t1 - t0));
+    t0 = millitime();
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        btree.find(key);
+    }
+    t1 = millitime();
+    notice("%.0f lookups/s with the string BTree", n / (t1 - t0));
+
+    finish(return);
+}
@@ -0,0 +1,142 @@
+#include "util/logging.hpp"
+#include "util/types.hpp"
+
+#include "BTree.hpp"
+#include "HashIndex.hpp"
+
+#include <vector>
+
+#include <stdio.h>
+
+
+typedef str_t<32> name_t;
+typedef HashIndex<uint32_t, name_t> hash_index_t;
+typedef BTree<uint32_t, name_t> btree_t;
+
+static const uint32_t n = 1024 * 1024;
+
+
+static inline void make_key(name_t& key, const uint32_t value) {
+    key.clear();
+    snprintf(key._data, sizeof(key._data), "entity #%u", value);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+    name_t key;
+    uint32_t value;
+
+    message("initialize hash index");
+    unlink("storage/test_8");
+    hash_index_t index("storage/test_8");
+
+    message("insert %u keys", n);
+    double t0 = millitime();
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        index.insert(key, v);
+    }
+    double t1 = millitime();
+    notice("%.0f inserts/s, %u buckets, %u overflow pages", n / (t1 - t0), index.buckets_count(), index.header->overflow_pages_count);
+    if (index.keys_count() != n || !index.check()) {
+        error("hash index is inconsistent");
+        finish(return);
+    }
+
+    message("find each key");
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        if (!index.find(key, value) || value != v) {
+            error("could not find `%s`", key.data());
+            finish(return);
+        }
+    }
+    notice("find missing keys");
+    for (uint32_t v=n; v<n+1024; v++) {
+        make_key(key, v);
+        if (index.contains(key)) {
+            error("found missing key `%s`", key.data());
+        }
+    }
+
+    message("duplicates");
+    key = "duplicate";
+    for (uint32_t i=0; i<5000; i++) {
+        index.insert(key, i);
+    }
+    uint32_t count = index.find(key, [](const uint32_t value) {
+        return true;
+    });
+    if (count != 5000) {
+        error("COUNT ERROR: %u != 5000 duplicates", count);
+    }
+    notice("erase them");
+    for (uint32_t i=0; i<5000; i++) {
+        if (!index.erase(key, i)) {
+            error("could not erase duplicate %u", i);
+            finish(return);
+        }
+    }
+    if (index.contains(key) || index.keys_count() != n || !index.check()) {
+        error("duplicates remain after erasing them");
+    }
+
+    message("erase every other key");
+    for (uint32_t v=0; v<n; v+=2) {
+        make_key(key, v);
+        if (!index.erase(key)) {
+            error("could not erase `%s`", key.data());
+            finish(return);
+        }
+    }
+    for (uint32_t v=0; v<n; v++) {
+        make_key(key, v);
+        if (index.contains(key) != (v % 2 == 1)) {
+            error("`%s` should%s be there", key.data(), (v % 2) ? "" : " not");
+            finish(return);
+        }
+    }
+
+    message("reopen");
+    index.flush();
+    {
+        hash_index_t reopened("storage/test_8");
+        count = reopened.scan([](const name_t& key, const uint32_t value) {
+            return true;
+        });
+        if (count != n / 2 || !reopened.check()) {
+            error("COUNT ERROR after reopening: %u != %u", count, n / 2);
+        }
+    }
+
+    message("compare with a BTree");
+    unlink("storage/test_8_btree");
+    btree_t btree("storage/test_8_btree");
+    for (uint32_t v=1; v<n; v+=2) {
+        make_key(key, v);
+        btree.insert(key, v);
+    }
+    // in random order
+    std::vector<uint32_t> values;
+    for (uint32_t v=1; v<n; v+=2) {
+        values.push_back((v * 2654435761u) % n | 1);
+    }
+    t0 = millitime();
+    for (uint32_t i=0; i<values.size(); i++) {
+        make_key(key, values[i]);
+        index.find(key, value);
+    }
+    t1 = millitime();
+    notice("%.0f lookups/s with the hash index", values.size() / (t1 - t0));
+    t0 = millitime();
+    for (uint32_t i=0; i<values.size(); i++) {
+        make_key(key, values[i]);
+        btree.find(key);
+    }
+    t1 = millitime();
+    notice("%.0f lookups/s with the BTree", values.size() / (t1 - t0));
+
+    finish(return);
+}
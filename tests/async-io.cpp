@@ -0,0 +1,73 @@
+#include "util/logging.hpp"
+
+#include "BTree.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+typedef BTree<uint32_t, uint64_t, 64*1024*1024> btree_t;
+
+static const char* path = "storage/async_io";
+static const uint64_t n = 4 * 1024 * 1024;
+static const uint64_t lookups_count = 64 * 1024;
+
+
+// evict a file from the kernel page cache, so that reads hit the disk
+void drop_cache(const char* path) {
+    const int handle = open(path, O_RDONLY);
+    fdatasync(handle);
+    posix_fadvise(handle, 0, 0, POSIX_FADV_DONTNEED);
+    close(handle);
+}
+
+static inline const uint64_t make_key(const uint64_t i) {
+    return 3 * ((i * 2654435761ul) % n);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("bulk load %lu keys", n);
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> entries(n);
+        for (uint64_t i=0; i<n; i++) {
+            entries[i] = std::pair<uint64_t, uint32_t>(3 * i, i);
+        }
+        btree_t btree(path, FILEPAGER_ASYNC);
+        btree.load(entries.begin(), entries.end());
+    }
+    std::vector<uint64_t> keys(lookups_count);
+    for (uint64_t i=0; i<lookups_count; i++) {
+        keys[i] = make_key(i);
+    }
+
+    message("%lu cold random lookups", lookups_count);
+    const char* names[] = {"one by one", "batched", "batched, async"};
+    const int flags[] = {FILEPAGER_RANDOM, FILEPAGER_RANDOM, FILEPAGER_RANDOM | FILEPAGER_ASYNC};
+    for (int m=0; m<3; m++) {
+        drop_cache(path);
+        btree_t btree(path, flags[m]);
+        std::vector<btree_t::cursor_t> cursors(lookups_count);
+        const double t0 = millitime();
+        if (m == 0) {
+            for (uint64_t i=0; i<lookups_count; i++) {
+                cursors[i] = btree.find(keys[i]);
+            }
+        } else {
+            btree.find_many(keys.data(), lookups_count, cursors.data());
+        }
+        const double t1 = millitime();
+        for (uint64_t i=0; i<lookups_count; i++) {
+            if (!(cursors[i] != btree.end()) || cursors[i].key() != keys[i] || cursors[i].value() != keys[i] / 3) {
+                error("could not find key %lu", keys[i]);
+                finish(return);
+            }
+        }
+        notice("%-16s %8.0f lookups/s", names[m], lookups_count / (t1 - t0));
+    }
+
+    finish(return);
+}
@@ -0,0 +1,80 @@
+#include "util/logging.hpp"
+#include "util/generators.hpp"
+#include "util/types.hpp"
+
+#include "BTree.hpp"
+
+#include <stdio.h>
+
+
+static const uint32_t n = 16 * 1024 * 1024;
+
+
+// page search as it was done before: linear scan
+template <typename page_t, typename key_t>
+inline const uint32_t linear_find(const page_t& page, const key_t& key) {
+    for (uint32_t i=0; i<page.header.keys_count; i++) {
+        if (key < page.keys[i]) {
+            return i;
+        }
+    }
+    return page.header.keys_count;
+}
+
+template <typename key_t>
+inline void make_key(key_t& key, const uint32_t value) {
+    key = value;
+}
+template <uint32_t size>
+inline void make_key(str_t<size>& key, const uint32_t value) {
+    snprintf(key._data, size, "%010u", value);
+}
+
+template <typename key_t>
+void benchmark(const char* name) {
+    typedef BTreePage<uint32_t, key_t, 4096> page_t;
+    page_t* page = new page_t;
+    const uint32_t keys_count = page_t::max_keys_count;
+    page->header.keys_count = keys_count;
+    for (uint32_t i=0; i<keys_count; i++) {
+        make_key(page->keys[i], 2 * i);
+    }
+    key_t* queries = new key_t[1024];
+    for (uint32_t i=0; i<1024; i++) {
+        make_key(queries[i], rand() % (2 * keys_count + 1));
+    }
+
+    notice("%s: %u keys per page", name, keys_count);
+    uint64_t checksum_linear = 0;
+    uint64_t checksum = 0;
+    double t0 = millitime();
+    for (uint32_t i=0; i<n; i++) {
+        checksum_linear += linear_find(*page, queries[i % 1024]);
+    }
+    double t1 = millitime();
+    for (uint32_t i=0; i<n; i++) {
+        checksum += page->find(queries[i % 1024]);
+    }
+    double t2 = millitime();
+    debug("linear scan: %6.2f ns/op", 1e9 * (t1 - t0) / n);
+    debug("page search: %6.2f ns/op", 1e9 * (t2 - t1) / n);
+    if (checksum != checksum_linear) {
+        error("checksums differ: %lu != %lu", checksum, checksum_linear);
+    }
+
+    delete [] queries;
+    delete page;
+}
+
+
+int main(int argc, char const *argv[]) {
+    start();
+
+    message("lookup %u keys in a single 4 KiB page", n);
+    benchmark<uint32_t>("uint32_t");
+    benchmark<int64_t>("int64_t");
+    benchmark<str_t<32>>("str_t<32>");
+    benchmark<str_t<256>>("str_t<256>");
+
+    finish(return);
+}
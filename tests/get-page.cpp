@@ -0,0 +1,84 @@
+#include "util/logging.hpp"
+
+#include "Counter.hpp"
+
+#include <unordered_map>
+
+#include <time.h>
+
+
+typedef Counter<uint64_t, uint32_t, 4096, 256> counter_t;
+
+static const uint64_t pages_count = 4096;
+static const uint64_t n = 16 * 1024 * 1024;
+
+
+static inline const uint64_t nanotime() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ul + t.tv_nsec;
+}
+
+// page indices below `range`, in random order
+static std::vector<uint32_t> make_indices(const uint64_t range) {
+    std::vector<uint32_t> indices(n);
+    uint64_t seed = 1;
+    for (uint64_t i=0; i<n; i++) {
+        seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+        indices[i] = (seed >> 33) % range;
+    }
+    return indices;
+}
+
+template <typename pager_t>
+void measure(const char* name, pager_t& pager, const std::vector<uint32_t>& indices) {
+    uint64_t sum = 0;
+    const uint64_t t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += pager.read_page(indices[i]).values[0];
+    }
+    const uint64_t t1 = nanotime();
+    notice("%-32s %6.1f ns/op (%lu)", name, (double) (t1 - t0) / n, sum);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("fill %lu pages", pages_count);
+    {
+        counter_t counter("storage/get_page", 16 * 1024 * 1024);
+        for (uint64_t i=0; i<pages_count*counter_t::values_per_page; i++) {
+            counter.append(i);
+        }
+    }
+    const std::vector<uint32_t> resident_indices = make_indices(256);
+    const std::vector<uint32_t> indices = make_indices(pages_count);
+
+    message("get_page, %lu random accesses", n);
+    {
+        counter_t counter("storage/get_page", 16 * 1024 * 1024, FILEPAGER_RANDOM);
+        measure("buffered, resident pages", counter, resident_indices);
+        measure("buffered, 1/16 resident pages", counter, indices);
+    }
+    {
+        counter_t counter("storage/get_page", 16 * 1024 * 1024, FILEPAGER_MAPPED | FILEPAGER_RANDOM);
+        measure("mapped", counter, indices);
+    }
+
+    message("for reference, hashed lookups of resident pages");
+    std::unordered_map<uint32_t, uint32_t> table;
+    for (uint32_t p=0; p<256; p++) {
+        table[p] = p;
+    }
+    uint64_t sum = 0;
+    const uint64_t t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += table.find(resident_indices[i])->second;
+    }
+    const uint64_t t1 = nanotime();
+    notice("%-32s %6.1f ns/op (%lu)", "std::unordered_map", (double) (t1 - t0) / n, sum);
+
+    finish(return);
+}
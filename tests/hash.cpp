@@ -0,0 +1,101 @@
+#include "util/logging.hpp"
+#include "util/types.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+#include <time.h>
+
+
+static const uint64_t n = 1024 * 1024;
+// keeps results from being optimized away
+static volatile uint64_t sink;
+
+
+static inline const uint64_t nanotime() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ul + t.tv_nsec;
+}
+
+// former std::hash<str_t>, for reference
+template <uint32_t size>
+struct legacy_hash {
+    inline std::size_t operator()(const str_t<size>& str) const {
+        const char* data = str.data();
+        std::size_t hash = 31;
+        while (*data) {
+            hash = (hash * 54059) ^ (data[0] * 76963);
+            data++;
+        }
+        return hash;
+    }
+};
+
+// distinct keys of `length` characters, with a common prefix
+template <uint32_t size>
+static std::vector<str_t<size>> make_keys(const uint32_t length) {
+    std::vector<str_t<size>> keys(n);
+    char buffer[size + 16];
+    for (uint64_t i=0; i<n; i++) {
+        const int prefix_length = snprintf(buffer, sizeof(buffer), "%0*lu", (int) length, (i * 2654435761ul) % n);
+        memcpy(keys[i]._data, buffer + prefix_length - length, length);
+        for (uint32_t c=0; c<length - 7; c++) {
+            keys[i]._data[c] = 'a' + c % 26;
+        }
+    }
+    return keys;
+}
+
+template <uint32_t size, typename hash_t>
+static void measure(const char* name, const uint32_t length) {
+    const std::vector<str_t<size>> keys = make_keys<size>(length);
+    hash_t hash;
+    // raw hashing
+    uint64_t sum = 0;
+    uint64_t t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += hash(keys[i]);
+    }
+    uint64_t t1 = nanotime();
+    const double hash_time = (double) (t1 - t0) / n;
+    // keys sharing their slot in a power of two sized table, as in HashIndex
+    std::vector<uint32_t> slots(n);
+    uint64_t collisions_count = 0;
+    for (uint64_t i=0; i<n; i++) {
+        collisions_count += (slots[hash(keys[i]) & (n - 1)]++ != 0);
+    }
+    // map lookups
+    std::unordered_map<str_t<size>, uint32_t, hash_t> map;
+    for (uint64_t i=0; i<n; i++) {
+        map[keys[i]] = i;
+    }
+    t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += map.find(keys[(i * 40503) % n])->second;
+    }
+    t1 = nanotime();
+    sink = sum;
+    notice("%-6s <%u>/%u: %.1f ns/hash, %.0f ns/find, %lu collided", name, size, length, hash_time, (double) (t1 - t0) / n, collisions_count);
+}
+
+template <uint32_t size>
+static void compare(const uint32_t length) {
+    measure<size, legacy_hash<size>>("legacy", length);
+    measure<size, std::hash<str_t<size>>>("wyhash", length);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("hash %lu distinct keys, for str_t<size>/length", n);
+    compare<16>(12);
+    compare<32>(24);
+    compare<256>(48);
+    compare<256>(200);
+
+    finish(return);
+}
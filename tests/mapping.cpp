@@ -0,0 +1,70 @@
+#include "util/logging.hpp"
+
+#include "BTree.hpp"
+
+#include <algorithm>
+
+#include <time.h>
+
+
+typedef BTree<uint32_t, uint64_t, 64*1024*1024> btree_t;
+
+static const char* path = "storage/mapping";
+static const uint64_t n = 4 * 1024 * 1024;
+static const uint64_t lookups_count = 1024 * 1024;
+
+
+static inline const uint64_t nanotime() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ul + t.tv_nsec;
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("bulk load %lu keys", n);
+    {
+        std::vector<std::pair<uint64_t, uint32_t>> entries(n);
+        for (uint64_t i=0; i<n; i++) {
+            entries[i] = std::pair<uint64_t, uint32_t>(i, i);
+        }
+        btree_t btree(path, FILEPAGER_MAPPED);
+        btree.load(entries.begin(), entries.end());
+    }
+
+    message("%lu random lookups with each mapping option", lookups_count);
+    const char* names[] = {"default", "populate", "huge pages", "huge pages, populate", "locked"};
+    const int flags[] = {0, FILEPAGER_POPULATE, FILEPAGER_HUGEPAGES, FILEPAGER_HUGEPAGES | FILEPAGER_POPULATE, FILEPAGER_LOCKED};
+    std::vector<uint64_t> latencies(lookups_count);
+    for (int o=0; o<5; o++) {
+        const uint64_t t0 = nanotime();
+        btree_t btree(path, FILEPAGER_MAPPED | FILEPAGER_RANDOM | flags[o]);
+        const uint64_t t1 = nanotime();
+        uint64_t seed = 1;
+        for (uint64_t i=0; i<lookups_count; i++) {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            const uint64_t key = (seed >> 11) % n;
+            const uint64_t t = nanotime();
+            auto it = btree.find(key);
+            latencies[i] = nanotime() - t;
+            if (!(it != btree.end()) || it.value() != key) {
+                error("could not find key %lu", key);
+                finish(return);
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+        uint64_t total = 0;
+        for (uint64_t i=0; i<lookups_count; i++) {
+            total += latencies[i];
+        }
+        notice("%-20s open %7.3f ms, lookups %5lu ns mean, %5lu ns median, %6lu ns p99",
+            names[o], (t1 - t0) / 1e6, total / lookups_count,
+            latencies[lookups_count / 2], latencies[lookups_count * 99 / 100]
+        );
+    }
+
+    finish(return);
+}
@@ -0,0 +1,82 @@
+#include "util/logging.hpp"
+
+#include "BTree.hpp"
+#include "Counter.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+typedef Counter<uint64_t, uint32_t, 4096, 256> counter_t;
+typedef BTree<uint32_t, uint64_t, 64*1024*1024> btree_t;
+
+static const uint64_t n = 8 * 1024 * 1024;
+
+
+// evict a file from the kernel page cache, so that reads hit the disk
+void drop_cache(const char* path) {
+    const int handle = open(path, O_RDONLY);
+    fdatasync(handle);
+    posix_fadvise(handle, 0, 0, POSIX_FADV_DONTNEED);
+    close(handle);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("fill a counter with %lu values", n);
+    {
+        counter_t counter("storage/readahead_counter", 64 * 1024 * 1024, FILEPAGER_MAPPED);
+        std::vector<uint64_t> values(1024 * 1024);
+        for (uint64_t i=0; i<n; i+=values.size()) {
+            for (uint64_t j=0; j<values.size(); j++) {
+                values[j] = i + j;
+            }
+            counter.append_many(values.data(), values.size());
+        }
+    }
+
+    message("cold sequential reads");
+    const char* names[] = {"buffered, random", "buffered", "mapped, random", "mapped"};
+    const int flags[] = {FILEPAGER_RANDOM, 0, FILEPAGER_MAPPED | FILEPAGER_RANDOM, FILEPAGER_MAPPED};
+    for (int f=0; f<4; f++) {
+        drop_cache("storage/readahead_counter");
+        counter_t counter("storage/readahead_counter", 64 * 1024 * 1024, flags[f]);
+        const double t0 = millitime();
+        uint64_t sum = 0;
+        for (uint64_t id=1; id<=n; id++) {
+            sum += counter.get(id);
+        }
+        const double t1 = millitime();
+        if (sum != n * (n - 1) / 2) {
+            error("wrong sum: %lu", sum);
+        }
+        notice("%-18s %8.1f MiB/s", names[f], n * sizeof(uint64_t) / (t1 - t0) / 1048576);
+    }
+
+    message("cold scans of a BTree filled in random order");
+    {
+        btree_t btree("storage/readahead_btree", FILEPAGER_MAPPED);
+        for (uint64_t i=0; i<n/8; i++) {
+            const uint64_t key = (i * 2654435761ul) % (n / 8);
+            btree.insert(key, key);
+        }
+    }
+    for (int f=2; f<4; f++) {
+        drop_cache("storage/readahead_btree");
+        btree_t btree("storage/readahead_btree", flags[f]);
+        const double t0 = millitime();
+        const uint64_t count = btree.scan(0, n, [](const uint64_t& key, const uint32_t& value) {
+            return true;
+        });
+        const double t1 = millitime();
+        if (count != n / 8) {
+            error("COUNT ERROR: %lu != %lu", count, n / 8);
+        }
+        notice("%-18s %8.0f keys/s", names[f], count / (t1 - t0));
+    }
+
+    finish(return);
+}
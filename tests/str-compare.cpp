@@ -0,0 +1,123 @@
+#include "util/logging.hpp"
+#include "util/types.hpp"
+
+#include "BTree.hpp"
+
+#include <new>
+#include <vector>
+
+#include <stdio.h>
+#include <time.h>
+
+
+static const uint64_t n = 1024 * 1024;
+// keys compared and copied over and over, so that they stay in cache
+static const uint64_t cached_count = 1024;
+// keeps results from being optimized away
+static volatile uint64_t sink;
+
+
+static inline const uint64_t nanotime() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ul + t.tv_nsec;
+}
+
+// former comparison and copy, for reference
+template <uint32_t size>
+static inline const int legacy_comp(const str_t<size>& a, const str_t<size>& b) {
+    return memcmp(a._data, b._data, size);
+}
+template <uint32_t size>
+static inline void legacy_copy(str_t<size>& destination, const str_t<size>& source) {
+    strncpy(destination._data, source._data, size);
+}
+template <uint32_t size>
+static inline const int current_comp(const str_t<size>& a, const str_t<size>& b) {
+    return a.comp(b);
+}
+template <uint32_t size>
+static inline void current_copy(str_t<size>& destination, const str_t<size>& source) {
+    new (&destination) str_t<size>(source);
+}
+
+// distinct keys, in random order
+template <uint32_t size>
+static std::vector<str_t<size>> make_keys(const uint32_t length) {
+    std::vector<str_t<size>> keys(n);
+    char buffer[size + 16];
+    for (uint64_t i=0; i<n; i++) {
+        snprintf(buffer, sizeof(buffer), "%0*lu", (int) length, (i * 2654435761ul) % n);
+        keys[i] = buffer;
+    }
+    return keys;
+}
+
+template <uint32_t size, const int comp(const str_t<size>&, const str_t<size>&), void copy(str_t<size>&, const str_t<size>&)>
+static void measure(const char* name, const std::vector<str_t<size>>& keys, const std::vector<str_t<size>>& copies) {
+    // comparisons between different keys, then between equal ones
+    int64_t sum = 0;
+    uint64_t t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += comp(keys[i & (cached_count - 1)], keys[(i + 1) & (cached_count - 1)]);
+    }
+    uint64_t t1 = nanotime();
+    const double different_time = (double) (t1 - t0) / n;
+    t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        sum += comp(keys[i & (cached_count - 1)], copies[i & (cached_count - 1)]);
+    }
+    t1 = nanotime();
+    const double equal_time = (double) (t1 - t0) / n;
+    // copies
+    str_t<size> key;
+    t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        copy(key, keys[i & (cached_count - 1)]);
+        sum += key._data[0];
+    }
+    t1 = nanotime();
+    sink = sum;
+    notice("%-7s compare %.1f/%.1f ns, copy %.1f ns", name, different_time, equal_time, (double) (t1 - t0) / n);
+}
+
+template <uint32_t size>
+static void compare(const uint32_t length) {
+    const std::vector<str_t<size>> keys = make_keys<size>(length);
+    const std::vector<str_t<size>> copies = keys;
+    message("str_t<%u> keys of %u characters", size, length);
+    measure<size, legacy_comp<size>, legacy_copy<size>>("legacy", keys, copies);
+    measure<size, current_comp<size>, current_copy<size>>("current", keys, copies);
+}
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("compare different/equal keys, and copy them");
+    compare<16>(12);
+    compare<32>(24);
+    compare<256>(24);
+    compare<256>(200);
+
+    // the whole tree fits in the buffer pool
+    message("BTree with %lu str_t<256> keys of 24 characters", n / 8);
+    unlink("storage/str_compare");
+    BTree<uint32_t, str_t<256>, 1024*1024, 4096, 16384> btree("storage/str_compare");
+    std::vector<str_t<256>> keys = make_keys<256>(24);
+    uint64_t t0 = nanotime();
+    for (uint64_t i=0; i<n/8; i++) {
+        btree.insert(keys[i], i);
+    }
+    uint64_t t1 = nanotime();
+    notice("%.0f ns/insert", (double) (t1 - t0) / (n / 8));
+    t0 = nanotime();
+    for (uint64_t i=0; i<n; i++) {
+        btree.find(keys[(i * 40503) % (n / 8)]);
+    }
+    t1 = nanotime();
+    notice("%.0f ns/find", (double) (t1 - t0) / n);
+
+    finish(return);
+}
@@ -0,0 +1,46 @@
+#include "util/logging.hpp"
+
+#include "BTree.hpp"
+
+
+// the whole tree fits in the buffer pool
+typedef BTree<uint32_t, uint64_t, 1024*1024, 4096, 2048> btree_t;
+
+static const uint64_t n = 512 * 1024;
+static const uint64_t lookups_count = 8 * 1024 * 1024;
+
+
+int main(int argc, char const *argv[]) {
+
+    start();
+
+    message("warm lookups among %lu keys, with and without swizzling", n);
+    const char* names[] = {"page table", "swizzled"};
+    const int flags[] = {0, BTREE_SWIZZLED};
+    for (int s=0; s<2; s++) {
+        unlink("storage/swizzle");
+        btree_t btree("storage/swizzle", flags[s]);
+        double t0 = millitime();
+        for (uint64_t i=0; i<n; i++) {
+            const uint64_t key = (i * 2654435761ul) % n;
+            btree.insert(key, key);
+        }
+        double t1 = millitime();
+        notice("%-12s %10.0f inserts/s", names[s], n / (t1 - t0));
+        uint64_t seed = 1;
+        t0 = millitime();
+        for (uint64_t i=0; i<lookups_count; i++) {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            const uint64_t key = (seed >> 11) % n;
+            auto it = btree.find(key);
+            if (!(it != btree.end()) || it.value() != key) {
+                error("could not find key %lu", key);
+                finish(return);
+            }
+        }
+        t1 = millitime();
+        notice("%-12s %10.0f lookups/s", names[s], lookups_count / (t1 - t0));
+    }
+
+    finish(return);
+}